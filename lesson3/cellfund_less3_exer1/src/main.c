@@ -32,6 +32,9 @@ static char rx_buffer[MESSAGE_SIZE];
 
 K_SEM_DEFINE(lte_connected, 0, 1);
 
+/* Uptime (ms) of the last switch to RRC connected mode. */
+static int64_t rrc_connected_since;
+
 LOG_MODULE_REGISTER(Lesson3_Exercise1, LOG_LEVEL_INF);
 
 static int server_resolve(void)
@@ -84,7 +87,6 @@ static int server_connect(void)
 {
 	int err;
 	/* STEP 7 - Create a UDP socket */
-	static int sock;
 	sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
 	if (sock < 0) 
 	{
@@ -116,6 +118,12 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 	case LTE_LC_EVT_RRC_UPDATE:
 		LOG_INF("RRC mode: %s", evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED ?
 				"Connected" : "Idle");
+		if (evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED) {
+			rrc_connected_since = k_uptime_get();
+		} else if (rrc_connected_since != 0) {
+			LOG_INF("RRC connected for %lld ms", k_uptime_get() - rrc_connected_since);
+			rrc_connected_since = 0;
+		}
 		break;
      default:
              break;
@@ -152,9 +160,16 @@ static int modem_configure(void)
 static void button_handler(uint32_t button_state, uint32_t has_changed)
 {
 	int res;
+	int rai = RAI_ONE_RESP;
 	switch (has_changed)
 	{
 		case DK_BTN1_MSK:
+			/* Only the echo is expected back, so the network can release
+			 * the RRC connection right after it.
+			 */
+			if (setsockopt(sock, SOL_SOCKET, SO_RAI, &rai, sizeof(rai)) < 0) {
+				LOG_WRN("Failed to set RAI: %d", errno);
+			}
 			/* STEP 9 - call send() when button 1 is pressed */
 			res = send(sock, MESSAGE_TO_SEND, SSTRLEN(MESSAGE_TO_SEND), 0);
 			if (res < 0) 
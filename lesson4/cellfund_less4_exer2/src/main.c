@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/socket.h>
 #include <zephyr/net/mqtt.h>
@@ -15,11 +16,13 @@
 #include <modem/lte_lc.h>
 
 #include "mqtt_connection.h"
+#include "publish_queue.h"
+#include "reconnect.h"
 
 /* The mqtt client struct */
 static struct mqtt_client client;
-/* File descriptor */
-static struct pollfd fds;
+/* File descriptors: the MQTT socket, and the wake-up of the publish queue */
+static struct pollfd fds[2];
 
 static K_SEM_DEFINE(lte_connected, 0, 1);
 
@@ -81,15 +84,36 @@ static int modem_configure(void)
 	return 0;
 }
 
+static void payload_handler(const struct mqtt_publish_param *p,
+			    const uint8_t *data, size_t len, size_t offset)
+{
+	LOG_INF("Received %u/%u bytes: %s", (unsigned int)(offset + len),
+		(unsigned int)p->message.payload.len, (const char *)data);
+
+	/* The LED commands are short, they are in the first slice. */
+	if (offset != 0) {
+		return;
+	}
+
+	if (strncmp((const char *)data, CONFIG_TURN_LED_ON_CMD,
+		    sizeof(CONFIG_TURN_LED_ON_CMD) - 1) == 0) {
+		dk_set_led_on(LED_CONTROL_OVER_MQTT);
+	} else if (strncmp((const char *)data, CONFIG_TURN_LED_OFF_CMD,
+			   sizeof(CONFIG_TURN_LED_OFF_CMD) - 1) == 0) {
+		dk_set_led_off(LED_CONTROL_OVER_MQTT);
+	}
+}
+
 static void button_handler(uint32_t button_state, uint32_t has_changed)
 {
 	switch (has_changed) {
 	case DK_BTN1_MSK:
 		if (button_state & DK_BTN1_MSK){
-			int err = data_publish(&client, MQTT_QOS_1_AT_LEAST_ONCE,
+			/* Queued for the MQTT thread, the button handler never blocks on the socket. */
+			int err = data_publish(MQTT_QOS_1_AT_LEAST_ONCE,
 				   CONFIG_BUTTON_EVENT_PUBLISH_MSG, sizeof(CONFIG_BUTTON_EVENT_PUBLISH_MSG)-1);
 			if (err) {
-				LOG_INF("Failed to send message, %d", err);
+				LOG_INF("Failed to queue message, %d", err);
 				return;
 			}
 		}
@@ -101,6 +125,7 @@ int main(void)
 {
 	int err;
 	uint32_t connect_attempt = 0;
+	int64_t connect_start;
 
 	if (dk_leds_init() != 0) {
 		LOG_ERR("Failed to initialize the LED library");
@@ -112,10 +137,18 @@ int main(void)
 		return 0;
 	}
 
+	err = publish_queue_init();
+	if (err) {
+		LOG_ERR("Failed to initialize the publish queue: %d", err);
+		return 0;
+	}
+
 	if (dk_buttons_init(button_handler) != 0) {
 		LOG_ERR("Failed to initialize the buttons library");
 	}
 
+	payload_handler_set(payload_handler);
+
 	err = client_init(&client);
 	if (err) {
 		LOG_ERR("Failed to initialize MQTT client: %d", err);
@@ -124,24 +157,28 @@ int main(void)
 
 do_connect:
 	if (connect_attempt++ > 0) {
-		LOG_INF("Reconnecting in %d seconds...",
-			CONFIG_MQTT_RECONNECT_DELAY_S);
-		k_sleep(K_SECONDS(CONFIG_MQTT_RECONNECT_DELAY_S));
+		reconnect_disconnected();
+		k_sleep(reconnect_delay_next());
 	}
+	connect_start = k_uptime_get();
 	err = mqtt_connect(&client);
 	if (err) {
 		LOG_ERR("Error in mqtt_connect: %d", err);
 		goto do_connect;
 	}
+	/* Much shorter when the TLS session was resumed. */
+	LOG_INF("TLS connection set up in %lld ms", k_uptime_get() - connect_start);
 
-	err = fds_init(&client,&fds);
+	err = fds_init(&client,&fds[0]);
 	if (err) {
 		LOG_ERR("Error in fds_init: %d", err);
 		return 0;
 	}
+	fds[1].fd = publish_queue_fd();
+	fds[1].events = POLLIN;
 
 	while (1) {
-		err = poll(&fds, 1, mqtt_keepalive_time_left(&client));
+		err = poll(fds, ARRAY_SIZE(fds), publish_queue_timeout(&client));
 		if (err < 0) {
 			LOG_ERR("Error in poll(): %d", errno);
 			break;
@@ -153,7 +190,7 @@ do_connect:
 			break;
 		}
 
-		if ((fds.revents & POLLIN) == POLLIN) {
+		if ((fds[0].revents & POLLIN) == POLLIN) {
 			err = mqtt_input(&client);
 			if (err != 0) {
 				LOG_ERR("Error in mqtt_input: %d", err);
@@ -161,15 +198,21 @@ do_connect:
 			}
 		}
 
-		if ((fds.revents & POLLERR) == POLLERR) {
+		if ((fds[0].revents & POLLERR) == POLLERR) {
 			LOG_ERR("POLLERR");
 			break;
 		}
 
-		if ((fds.revents & POLLNVAL) == POLLNVAL) {
+		if ((fds[0].revents & POLLNVAL) == POLLNVAL) {
 			LOG_ERR("POLLNVAL");
 			break;
 		}
+
+		err = publish_queue_process(&client);
+		if (err) {
+			LOG_ERR("Error in publish_queue_process: %d", err);
+			break;
+		}
 	}
 
 	LOG_INF("Disconnecting MQTT client");
@@ -4,11 +4,12 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/socket.h>
-#include <zephyr/random/rand32.h>
 #include <zephyr/net/mqtt.h>
 
 #include <dk_buttons_and_leds.h>
 #include "mqtt_connection.h"
+#include "publish_queue.h"
+#include "reconnect.h"
 #include <nrf_modem_at.h>
 
 /* STEP 2.4 - Include the header file for the modem key management library */
@@ -20,7 +21,12 @@
 /* Buffers for MQTT client. */
 static uint8_t rx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
 static uint8_t tx_buffer[CONFIG_MQTT_MESSAGE_BUFFER_SIZE];
-static uint8_t payload_buf[CONFIG_MQTT_PAYLOAD_BUFFER_SIZE];
+/* One slice of a received payload, and a '\0'. */
+static uint8_t payload_buf[CONFIG_MQTT_PAYLOAD_BUFFER_SIZE + 1];
+static payload_handler_t payload_handler;
+/* Packet id of the SUBSCRIBE, and whether the broker has the subscription. */
+static uint16_t subscribe_id;
+static bool subscribed;
 
 /* MQTT Broker details. */
 static struct sockaddr_storage broker;
@@ -107,39 +113,40 @@ int certificate_provision()
 	return err;
 }
 
-/**@brief Function to get the payload of recived data.
+/**@brief Function to read the payload of received data, slice by slice.
+ * Every slice is handed to the payload handler as soon as it is read, so
+ * payloads of any size are handled with the payload buffer.
  */
-static int get_received_payload(struct mqtt_client *c, size_t length)
+static int payload_stream(struct mqtt_client *c, const struct mqtt_publish_param *p)
 {
 	int ret;
-	int err = 0;
+	size_t offset = 0;
+	size_t length = p->message.payload.len;
 
-	/* Return an error if the payload is larger than the payload buffer.
-	 * Note: To allow new messages, we have to read the payload before returning.
-	 */
-	if (length > sizeof(payload_buf)) {
-		err = -EMSGSIZE;
-	}
-
-	/* Truncate payload until it fits in the payload buffer. */
-	while (length > sizeof(payload_buf)) {
+	/* Note: To allow new messages, the whole payload has to be read, even without a handler. */
+	while (offset < length) {
 		ret = mqtt_read_publish_payload_blocking(
-				c, payload_buf, (length - sizeof(payload_buf)));
+				c, payload_buf, MIN(length - offset, CONFIG_MQTT_PAYLOAD_BUFFER_SIZE));
 		if (ret == 0) {
 			return -EIO;
 		} else if (ret < 0) {
 			return ret;
 		}
 
-		length -= ret;
-	}
+		payload_buf[ret] = '\0';
+		if (payload_handler != NULL) {
+			payload_handler(p, payload_buf, ret, offset);
+		}
 
-	ret = mqtt_readall_publish_payload(c, payload_buf, length);
-	if (ret) {
-		return ret;
+		offset += ret;
 	}
 
-	return err;
+	return 0;
+}
+
+void payload_handler_set(payload_handler_t handler)
+{
+	payload_handler = handler;
 }
 
 /**@brief Function to subscribe to the configured topic
@@ -157,7 +164,7 @@ static int subscribe(struct mqtt_client *const c)
 	const struct mqtt_subscription_list subscription_list = {
 		.list = &subscribe_topic,
 		.list_count = 1,
-		.message_id = 1234
+		.message_id = subscribe_id = mqtt_message_id_next()
 	};
 
 	LOG_INF("Subscribing to: %s len %u", CONFIG_MQTT_SUB_TOPIC,
@@ -166,40 +173,6 @@ static int subscribe(struct mqtt_client *const c)
 	return mqtt_subscribe(c, &subscription_list);
 }
 
-/**@brief Function to print strings without null-termination
- */
-static void data_print(uint8_t *prefix, uint8_t *data, size_t len)
-{
-	char buf[len + 1];
-
-	memcpy(buf, data, len);
-	buf[len] = 0;
-	LOG_INF("%s%s", (char *)prefix, (char *)buf);
-}
-
-/**@brief Function to publish data on the configured topic
- */
-int data_publish(struct mqtt_client *c, enum mqtt_qos qos,
-	uint8_t *data, size_t len)
-{
-	struct mqtt_publish_param param;
-
-	param.message.topic.qos = qos;
-	param.message.topic.topic.utf8 = CONFIG_MQTT_PUB_TOPIC;
-	param.message.topic.topic.size = strlen(CONFIG_MQTT_PUB_TOPIC);
-	param.message.payload.data = data;
-	param.message.payload.len = len;
-	param.message_id = sys_rand32_get();
-	param.dup_flag = 0;
-	param.retain_flag = 0;
-
-	data_print("Publishing: ", data, len);
-	LOG_INF("to topic: %s len: %u",
-		CONFIG_MQTT_PUB_TOPIC,
-		(unsigned int)strlen(CONFIG_MQTT_PUB_TOPIC));
-
-	return mqtt_publish(c, &param);
-}
 /**@brief MQTT client event handler
  */
 void mqtt_evt_handler(struct mqtt_client *const c,
@@ -215,11 +188,24 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		}
 
 		LOG_INF("MQTT client connected");
-		subscribe(c);
+		reconnect_connected();
+		/* With a persistent session the broker keeps the subscription, and
+		 * queues the QoS 1 messages sent to it while the device was offline.
+		 */
+		if (!evt->param.connack.session_present_flag) {
+			subscribed = false;
+		}
+		if (subscribed) {
+			LOG_INF("Session resumed, already subscribed to %s", CONFIG_MQTT_SUB_TOPIC);
+		} else {
+			subscribe(c);
+		}
+		publish_queue_connected(&evt->param.connack);
 		break;
 
 	case MQTT_EVT_DISCONNECT:
 		LOG_INF("MQTT client disconnected: %d", evt->result);
+		publish_queue_disconnected();
 		break;
 
 	case MQTT_EVT_PUBLISH:
@@ -229,8 +215,8 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		LOG_INF("MQTT PUBLISH result=%d len=%d",
 			evt->result, p->message.payload.len);
 
-		//Extract the data of the recived message 
-		err = get_received_payload(c, p->message.payload.len);
+		//Hand the data of the recived message to the application
+		err = payload_stream(c, p);
 		
 		//Send acknowledgment to the broker on receiving QoS1 publish message 
 		if (p->message.topic.qos == MQTT_QOS_1_AT_LEAST_ONCE) {
@@ -242,24 +228,9 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 			mqtt_publish_qos1_ack(c, &ack);
 		}
 		
-		//On successful extraction of data 
-		if (err >= 0) {
-			data_print("Received: ", payload_buf, p->message.payload.len);
-			// Control the LED 
-			if(strncmp(payload_buf,CONFIG_TURN_LED_ON_CMD,sizeof(CONFIG_TURN_LED_ON_CMD)-1) == 0){
-				dk_set_led_on(LED_CONTROL_OVER_MQTT);
-			}
-			else if(strncmp(payload_buf,CONFIG_TURN_LED_OFF_CMD,sizeof(CONFIG_TURN_LED_OFF_CMD)-1) == 0){
-				dk_set_led_off(LED_CONTROL_OVER_MQTT);
-			}
-		// On failed extraction of data - Payload buffer is smaller than the recived data . Increase 
-		} else if (err == -EMSGSIZE) {
-			LOG_ERR("Received payload (%d bytes) is larger than the payload buffer "
-				"size (%d bytes).",
-				p->message.payload.len, sizeof(payload_buf));
 		//On failed extraction of data - Failed to extract data, disconnect 
-		} else {
-			LOG_ERR("get_received_payload failed: %d", err);
+		if (err < 0) {
+			LOG_ERR("payload_stream failed: %d", err);
 			LOG_INF("Disconnecting MQTT client...");
 
 			err = mqtt_disconnect(c);
@@ -276,6 +247,7 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		}
 
 		LOG_INF("PUBACK packet id: %u", evt->param.puback.message_id);
+		publish_queue_ack(evt->param.puback.message_id);
 		break;
 
 	case MQTT_EVT_SUBACK:
@@ -285,6 +257,10 @@ void mqtt_evt_handler(struct mqtt_client *const c,
 		}
 
 		LOG_INF("SUBACK packet id: %u", evt->param.suback.message_id);
+		if (evt->param.suback.message_id == subscribe_id) {
+			/* Without a persistent session it is gone at the next connection. */
+			subscribed = !c->clean_session;
+		}
 		break;
 
 	case MQTT_EVT_PINGRESP:
@@ -433,9 +409,8 @@ int client_init(struct mqtt_client *client)
 	tls_config->cipher_list = NULL;
 	tls_config->sec_tag_count = ARRAY_SIZE(sec_tag_list);
 	tls_config->sec_tag_list = sec_tag_list;
-	tls_config->session_cache = IS_ENABLED(CONFIG_MQTT_TLS_SESSION_CACHING) ?
-								TLS_SESSION_CACHE_ENABLED :
-								TLS_SESSION_CACHE_DISABLED;
+	/* Reconnections resume the TLS session instead of a full handshake. */
+	tls_config->session_cache = TLS_SESSION_CACHE_ENABLED;
 	tls_config->hostname = CONFIG_MQTT_BROKER_HOSTNAME;
 	tls_config->cert_nocopy = TLS_CERT_NOCOPY_NONE;
 	tls_config->set_native_tls = 0;
@@ -5,6 +5,20 @@
 #define CGSN_RESPONSE_LENGTH (IMEI_LEN + 6 + 1) /* Add 6 for \r\nOK\r\n and 1 for \0 */
 #define CLIENT_ID_LEN sizeof("nrf-") + IMEI_LEN
 
+/**@brief Handler of a received payload, called for every slice of it in order.
+ *
+ * A slice has up to CONFIG_MQTT_PAYLOAD_BUFFER_SIZE bytes and is followed by
+ * a '\0'. @p offset is the position of the slice in the payload, the
+ * payload length is p->message.payload.len. The slice is only valid during
+ * the call.
+ */
+typedef void (*payload_handler_t)(const struct mqtt_publish_param *p,
+				  const uint8_t *data, size_t len, size_t offset);
+
+/**@brief Set the handler of received payloads
+ */
+void payload_handler_set(payload_handler_t handler);
+
 /**@brief Initialize the MQTT client structure
  */
 int client_init(struct mqtt_client *client);
@@ -13,11 +27,6 @@ int client_init(struct mqtt_client *client);
  */
 int fds_init(struct mqtt_client *c, struct pollfd *fds);
 
-/**@brief Function to publish data on the configured topic
- */
-int data_publish(struct mqtt_client *c, enum mqtt_qos qos,
-	uint8_t *data, size_t len);
-
 /**@brief Function to write the server x.509 root certificate to the modem 
  */
 int certificate_provision(void);
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/mqtt.h>
+#include <zephyr/posix/sys/eventfd.h>
+
+#include "publish_queue.h"
+
+LOG_MODULE_DECLARE(Lesson4_Exercise2);
+
+#define RETRY_TIMEOUT_MS (CONFIG_MQTT_PUBLISH_RETRY_TIMEOUT_S * MSEC_PER_SEC)
+
+struct publish_msg {
+	enum mqtt_qos qos;
+	size_t len;
+	uint8_t data[CONFIG_MQTT_PUBLISH_PAYLOAD_MAX];
+};
+
+/* A QoS 1 message waiting for its PUBACK. */
+struct inflight {
+	bool used;
+	uint16_t message_id;
+	uint8_t attempts;
+	int64_t sent_at;
+	struct publish_msg msg;
+};
+
+K_MSGQ_DEFINE(publish_msgq, sizeof(struct publish_msg), CONFIG_MQTT_PUBLISH_QUEUE_SIZE, 4);
+/* Readable when data_publish() queued a message, wakes up the MQTT thread. */
+static int wakeup_fd = -1;
+
+/* Only used from the MQTT thread. */
+static struct inflight window[CONFIG_MQTT_PUBLISH_WINDOW];
+static uint16_t last_message_id;
+static bool connected;
+
+uint16_t mqtt_message_id_next(void)
+{
+	/* Packet identifier 0 is not allowed. */
+	if (++last_message_id == 0) {
+		last_message_id = 1;
+	}
+
+	return last_message_id;
+}
+
+int data_publish(enum mqtt_qos qos, const uint8_t *data, size_t len)
+{
+	struct publish_msg msg = {
+		.qos = qos,
+		.len = len,
+	};
+
+	if (len > sizeof(msg.data)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(msg.data, data, len);
+
+	if (k_msgq_put(&publish_msgq, &msg, K_NO_WAIT) != 0) {
+		return -ENOBUFS;
+	}
+
+	if (eventfd_write(wakeup_fd, 1) != 0) {
+		/* Sent when the MQTT thread wakes up for something else. */
+		LOG_WRN("Failed to wake up the MQTT thread, %d", errno);
+	}
+
+	return 0;
+}
+
+int publish_queue_init(void)
+{
+	wakeup_fd = eventfd(0, EFD_NONBLOCK);
+	if (wakeup_fd < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+int publish_queue_fd(void)
+{
+	return wakeup_fd;
+}
+
+static int publish_send(struct mqtt_client *c, const struct publish_msg *msg,
+			uint16_t message_id, bool dup)
+{
+	struct mqtt_publish_param param = {
+		.message.topic.qos = msg->qos,
+		.message.topic.topic.utf8 = CONFIG_MQTT_PUB_TOPIC,
+		.message.topic.topic.size = strlen(CONFIG_MQTT_PUB_TOPIC),
+		.message.payload.data = (uint8_t *)msg->data,
+		.message.payload.len = msg->len,
+		.message_id = message_id,
+		.dup_flag = dup,
+		.retain_flag = 0,
+	};
+
+	LOG_INF("Publishing %u bytes to %s, packet id %u%s", (unsigned int)msg->len,
+		CONFIG_MQTT_PUB_TOPIC, message_id, dup ? " (DUP)" : "");
+
+	return mqtt_publish(c, &param);
+}
+
+static struct inflight *window_slot_get(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(window); i++) {
+		if (!window[i].used) {
+			return &window[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Whether the next queued message can be sent now. */
+static bool queue_ready(void)
+{
+	struct publish_msg msg;
+
+	if (k_msgq_peek(&publish_msgq, &msg) != 0) {
+		return false;
+	}
+
+	return (msg.qos == MQTT_QOS_0_AT_MOST_ONCE) || (window_slot_get() != NULL);
+}
+
+static int window_retransmit(struct mqtt_client *c)
+{
+	int err;
+	int64_t now = k_uptime_get();
+
+	for (size_t i = 0; i < ARRAY_SIZE(window); i++) {
+		struct inflight *f = &window[i];
+
+		if (!f->used || ((now - f->sent_at) < RETRY_TIMEOUT_MS)) {
+			continue;
+		}
+
+		if (f->attempts >= CONFIG_MQTT_PUBLISH_MAX_ATTEMPTS) {
+			LOG_WRN("No PUBACK for packet id %u after %u attempts, dropping it",
+				f->message_id, f->attempts);
+			f->used = false;
+			continue;
+		}
+
+		f->sent_at = now;
+		err = publish_send(c, &f->msg, f->message_id, f->attempts++ > 0);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int publish_queue_process(struct mqtt_client *c)
+{
+	int err;
+	struct inflight *f;
+	struct publish_msg msg;
+	eventfd_t wakeups;
+
+	/* The queue is read below, so the pending wake-ups are handled. */
+	(void)eventfd_read(wakeup_fd, &wakeups);
+
+	if (!connected) {
+		return 0;
+	}
+
+	err = window_retransmit(c);
+	if (err) {
+		return err;
+	}
+
+	while (queue_ready()) {
+		(void)k_msgq_get(&publish_msgq, &msg, K_NO_WAIT);
+
+		if (msg.qos == MQTT_QOS_0_AT_MOST_ONCE) {
+			err = publish_send(c, &msg, mqtt_message_id_next(), false);
+			if (err) {
+				return err;
+			}
+			continue;
+		}
+
+		/* Take the slot before sending, so a failed send is retried. */
+		f = window_slot_get();
+		f->used = true;
+		f->message_id = mqtt_message_id_next();
+		f->attempts = 1;
+		f->sent_at = k_uptime_get();
+		f->msg = msg;
+
+		err = publish_send(c, &f->msg, f->message_id, false);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+int publish_queue_timeout(struct mqtt_client *c)
+{
+	/* New messages wake up poll() through wakeup_fd, so without messages in
+	 * flight only the keepalive is due. -1 if the keepalive is disabled.
+	 */
+	int64_t timeout = mqtt_keepalive_time_left(c);
+	int64_t now = k_uptime_get();
+
+	if (!connected) {
+		return timeout;
+	}
+
+	if (queue_ready()) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(window); i++) {
+		if (!window[i].used) {
+			continue;
+		}
+		if (timeout < 0) {
+			timeout = INT_MAX;
+		}
+		timeout = MIN(timeout, MAX(window[i].sent_at + RETRY_TIMEOUT_MS - now, 0));
+	}
+
+	return timeout;
+}
+
+void publish_queue_ack(uint16_t message_id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(window); i++) {
+		if (window[i].used && (window[i].message_id == message_id)) {
+			LOG_INF("Packet id %u acknowledged after %lld ms", message_id,
+				k_uptime_get() - window[i].sent_at);
+			window[i].used = false;
+			return;
+		}
+	}
+
+	LOG_WRN("PUBACK for unknown packet id %u", message_id);
+}
+
+void publish_queue_connected(const struct mqtt_connack_param *connack)
+{
+	connected = true;
+
+	for (size_t i = 0; i < ARRAY_SIZE(window); i++) {
+		/* Due right away. A resumed session expects the same packet ids with
+		 * the DUP flag, a new one knows nothing about them.
+		 */
+		window[i].sent_at = k_uptime_get() - RETRY_TIMEOUT_MS;
+		if (!connack->session_present_flag) {
+			window[i].attempts = 0;
+		}
+	}
+}
+
+void publish_queue_disconnected(void)
+{
+	connected = false;
+}
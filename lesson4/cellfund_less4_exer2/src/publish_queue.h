@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _PUBLISH_QUEUE_H_
+#define _PUBLISH_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/mqtt.h>
+
+/* Publishing from any thread through a message queue.
+ *
+ * Only the thread that owns the MQTT client, the one running the poll()
+ * loop, touches the socket. Other threads queue their messages with
+ * data_publish() and never block. The queue has an eventfd that the MQTT
+ * thread polls together with the MQTT socket, so it wakes up for a new
+ * message and can otherwise sleep until the keepalive is due. It sends
+ * the messages with publish_queue_process() and keeps up to
+ * CONFIG_MQTT_PUBLISH_WINDOW QoS 1 messages in flight, so a burst is
+ * pipelined instead of waiting for every PUBACK. A message that is not
+ * acknowledged within CONFIG_MQTT_PUBLISH_RETRY_TIMEOUT_S seconds is sent
+ * again with the DUP flag.
+ */
+
+/**@brief Queue data for publishing on the configured topic.
+ *
+ * Can be called from any thread, does not block.
+ *
+ * @return 0 on success, -EMSGSIZE if @p len is larger than
+ *	   CONFIG_MQTT_PUBLISH_PAYLOAD_MAX, or -ENOBUFS if the queue is full.
+ */
+int data_publish(enum mqtt_qos qos, const uint8_t *data, size_t len);
+
+/**@brief Create the descriptor that wakes up the MQTT thread.
+ *
+ * Called once, before data_publish() is used.
+ *
+ * @return 0 on success, or a negative error code from eventfd().
+ */
+int publish_queue_init(void);
+
+/**@brief Descriptor to poll with the MQTT socket.
+ *
+ * Readable when a message was queued, publish_queue_process() clears it.
+ */
+int publish_queue_fd(void);
+
+/**@brief Send the queued messages that fit in the window, and retransmit the
+ * unacknowledged ones that timed out.
+ *
+ * Called from the MQTT thread while connected.
+ */
+int publish_queue_process(struct mqtt_client *c);
+
+/**@brief Longest time (in milliseconds) to wait in poll() before calling
+ * publish_queue_process() again.
+ *
+ * The next retransmission or the keepalive of @p c, whichever is due first.
+ * -1 to wait for the descriptors only.
+ */
+int publish_queue_timeout(struct mqtt_client *c);
+
+/**@brief Release the message acknowledged by a PUBACK. */
+void publish_queue_ack(uint16_t message_id);
+
+/**@brief Start publishing after the CONNACK.
+ *
+ * The messages still in flight from the last connection are sent again,
+ * with their packet ids and the DUP flag if the broker resumed the session.
+ */
+void publish_queue_connected(const struct mqtt_connack_param *connack);
+
+/**@brief Stop publishing until the next CONNACK. */
+void publish_queue_disconnected(void);
+
+/**@brief Get the next packet identifier, shared by all MQTT requests. */
+uint16_t mqtt_message_id_next(void);
+
+#endif /* _PUBLISH_QUEUE_H_ */
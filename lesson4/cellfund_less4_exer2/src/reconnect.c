@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/random/rand32.h>
+
+#include "reconnect.h"
+
+LOG_MODULE_DECLARE(Lesson4_Exercise2);
+
+#define MAX_DELAY_MS ((int64_t)CONFIG_MQTT_RECONNECT_MAX_DELAY_S * MSEC_PER_SEC)
+
+/* Uptime of the disconnect, -1 while connected. */
+static int64_t disconnected_at = -1;
+static uint32_t attempts;
+
+/* Reconnection statistics. */
+static uint32_t reconnects;
+static int64_t offline_total_ms;
+static int64_t offline_max_ms;
+
+void reconnect_disconnected(void)
+{
+	if (disconnected_at < 0) {
+		disconnected_at = k_uptime_get();
+		attempts = 0;
+	}
+}
+
+k_timeout_t reconnect_delay_next(void)
+{
+	int64_t delay = CONFIG_MQTT_RECONNECT_MIN_DELAY_MS;
+	int64_t jittered;
+
+	for (uint32_t i = 0; (i < attempts) && (delay < MAX_DELAY_MS); i++) {
+		delay *= 2;
+	}
+	delay = MIN(delay, MAX_DELAY_MS);
+
+	/* Between half and all of the delay. */
+	jittered = delay / 2 + sys_rand32_get() % (delay / 2 + 1);
+	attempts++;
+
+	LOG_INF("Reconnection attempt %u in %lld ms", attempts, jittered);
+
+	return K_MSEC(jittered);
+}
+
+void reconnect_connected(void)
+{
+	int64_t offline_ms;
+
+	if (disconnected_at < 0) {
+		return;
+	}
+
+	offline_ms = k_uptime_get() - disconnected_at;
+	disconnected_at = -1;
+
+	reconnects++;
+	offline_total_ms += offline_ms;
+	offline_max_ms = MAX(offline_max_ms, offline_ms);
+
+	LOG_INF("Reconnected after %lld ms and %u attempts", offline_ms, attempts);
+	LOG_INF("%u reconnections, avg %lld ms, max %lld ms offline", reconnects,
+		offline_total_ms / reconnects, offline_max_ms);
+}
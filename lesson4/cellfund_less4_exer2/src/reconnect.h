@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _RECONNECT_H_
+#define _RECONNECT_H_
+
+#include <zephyr/kernel.h>
+
+/* Reconnection to the broker with exponential backoff and jitter.
+ *
+ * The first attempt after a disconnect waits about
+ * CONFIG_MQTT_RECONNECT_MIN_DELAY_MS, and every failed attempt doubles the
+ * delay up to CONFIG_MQTT_RECONNECT_MAX_DELAY_S. The delay is randomized
+ * between half and all of it, so devices that lost the broker at the same
+ * time do not all come back at the same time. The backoff is reset by a
+ * successful CONNACK.
+ */
+
+/**@brief Record that the connection to the broker was lost, or not set up. */
+void reconnect_disconnected(void);
+
+/**@brief Get the delay before the next connection attempt. */
+k_timeout_t reconnect_delay_next(void);
+
+/**@brief Record a successful CONNACK and log the time since the disconnect. */
+void reconnect_connected(void);
+
+#endif /* _RECONNECT_H_ */
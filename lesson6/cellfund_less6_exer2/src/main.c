@@ -39,6 +39,9 @@ static uint8_t recv_buf[MESSAGE_SIZE];
 
 static K_SEM_DEFINE(lte_connected, 0, 1);
 
+/* Uptime (ms) of the last switch to RRC connected mode. */
+static int64_t rrc_connected_since;
+
 LOG_MODULE_REGISTER(Lesson6_Exercise2, LOG_LEVEL_INF);
 
 static int server_resolve(void)
@@ -115,6 +118,13 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 			LOG_INF("RRC mode: %s",
 					evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED ?
 					"Connected" : "Idle");
+			if (evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED) {
+				rrc_connected_since = k_uptime_get();
+			} else if (rrc_connected_since != 0) {
+				LOG_INF("RRC connected for %lld ms",
+					k_uptime_get() - rrc_connected_since);
+				rrc_connected_since = 0;
+			}
 			break;
 
 		/* STEP 9.1 - On event PSM update, print PSM paramters and check if was enabled */
@@ -335,10 +345,17 @@ static int gnss_init_and_start(void)
 static void button_handler(uint32_t button_state, uint32_t has_changed)
 {
 	int err;
+	int rai = RAI_ONE_RESP;
 	/* STEP 3.3 - Upon button 1 push, send gps_data */
 	switch (has_changed)
 	{
 	case DK_BTN1_MSK:
+		/* Only the echo is expected back, so the network can release
+		 * the RRC connection right after it.
+		 */
+		if (setsockopt(sock, SOL_SOCKET, SO_RAI, &rai, sizeof(rai)) < 0) {
+			LOG_WRN("Failed to set RAI: %d", errno);
+		}
 		err = send(sock, &gps_data, sizeof(gps_data), 0);
 		if (err < 0) {
 			LOG_ERR("Failed to send data to server: %d", errno);
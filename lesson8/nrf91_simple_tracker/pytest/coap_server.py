@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+"""Minimal CoAP server standing in for the tracker server on the host.
+
+Answers the uploads of the tracker, and implements the cell location resolver
+of CONFIG_TRACKER_CELL_FALLBACK. Only what the tracker uses is supported: no
+DTLS, no block-wise transfer, no observe. Build the tracker for native_sim with
+
+    CONFIG_COAP_SERVER_HOSTNAME="127.0.0.1"
+    CONFIG_COAP_SERVER_PORT=5683
+
+to run it against this server.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import threading
+from dataclasses import dataclass, field
+
+COAP_VERSION = 1
+
+TYPE_CON = 0
+TYPE_NON = 1
+TYPE_ACK = 2
+TYPE_RST = 3
+
+CODE_EMPTY = 0x00
+CODE_CREATED = 0x41
+CODE_CHANGED = 0x44
+CODE_CONTENT = 0x45
+CODE_BAD_REQUEST = 0x80
+CODE_NOT_FOUND = 0x84
+
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+OPTION_URI_QUERY = 15
+
+CONTENT_FORMAT_TEXT_PLAIN = 0
+
+# Cell positions of the resolver, by (mcc, mnc, tac, cell id). The first one
+# is the serving cell of the modem simulation.
+CELLS = {
+    (242, 1, 0x0B7B, 0x0133D502): (63.4305, 10.3951, 1500),
+}
+
+
+@dataclass
+class Message:
+    type: int
+    code: int
+    message_id: int
+    token: bytes = b''
+    options: list = field(default_factory=list)
+    payload: bytes = b''
+
+    def option_values(self, number):
+        return [value for num, value in self.options if num == number]
+
+    @property
+    def path(self):
+        return '/'.join(v.decode() for v in self.option_values(OPTION_URI_PATH))
+
+    @property
+    def queries(self):
+        return [v.decode() for v in self.option_values(OPTION_URI_QUERY)]
+
+
+def _ext_parse(value, data, pos):
+    if value == 13:
+        return data[pos] + 13, pos + 1
+    if value == 14:
+        return struct.unpack_from('!H', data, pos)[0] + 269, pos + 2
+    if value == 15:
+        raise ValueError('reserved option nibble')
+    return value, pos
+
+
+def _ext_encode(value):
+    if value < 13:
+        return value, b''
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack('!H', value - 269)
+
+
+def parse(data):
+    """Parse a CoAP message, see RFC 7252 section 3."""
+    if len(data) < 4 or (data[0] >> 6) != COAP_VERSION:
+        raise ValueError('not a CoAP message')
+
+    tkl = data[0] & 0x0F
+    msg = Message(type=(data[0] >> 4) & 0x03, code=data[1],
+                  message_id=struct.unpack_from('!H', data, 2)[0],
+                  token=bytes(data[4:4 + tkl]))
+    pos = 4 + tkl
+    number = 0
+
+    while pos < len(data):
+        if data[pos] == 0xFF:
+            msg.payload = bytes(data[pos + 1:])
+            break
+
+        delta, length = data[pos] >> 4, data[pos] & 0x0F
+        delta, pos = _ext_parse(delta, data, pos + 1)
+        length, pos = _ext_parse(length, data, pos)
+        number += delta
+        msg.options.append((number, bytes(data[pos:pos + length])))
+        pos += length
+
+    return msg
+
+
+def encode(msg):
+    """Encode a CoAP message, options are sorted by number."""
+    out = bytearray([(COAP_VERSION << 6) | (msg.type << 4) | len(msg.token), msg.code])
+    out += struct.pack('!H', msg.message_id) + msg.token
+    number = 0
+
+    for num, value in sorted(msg.options, key=lambda o: o[0]):
+        delta, delta_ext = _ext_encode(num - number)
+        length, length_ext = _ext_encode(len(value))
+        out += bytes([(delta << 4) | length]) + delta_ext + length_ext + value
+        number = num
+
+    if msg.payload:
+        out += b'\xff' + msg.payload
+
+    return bytes(out)
+
+
+def uint_option(value):
+    """Encode an unsigned integer option value in as few bytes as possible."""
+    return value.to_bytes((value.bit_length() + 7) // 8, 'big')
+
+
+def resolve(payload):
+    """Location resolver: serving cell line in, "lat,lon,accuracy" out."""
+    try:
+        serving = payload.decode().splitlines()[0].split(',')
+        key = tuple(int(v) for v in serving[:4])
+    except (UnicodeDecodeError, IndexError, ValueError):
+        return CODE_BAD_REQUEST, b''
+
+    if len(serving) != 5 or key not in CELLS:
+        return CODE_NOT_FOUND, b''
+
+    return CODE_CONTENT, '{},{},{}'.format(*CELLS[key]).encode()
+
+
+class CoapServer:
+    """CoAP server on a UDP socket, served from a thread.
+
+    Handlers are called with the request and return the response code,
+    payload and a list of extra (number, value) options. Requests to other
+    resources are answered with 2.04 Changed. Every request is kept in
+    `requests`.
+    """
+
+    def __init__(self, host='127.0.0.1', port=5683):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind((host, port))
+        self.sock.settimeout(0.2)
+        self.handlers = {}
+        self.requests = []
+        self.lock = threading.Lock()
+        self.running = False
+        self.thread = threading.Thread(target=self._serve, daemon=True)
+
+    def resource(self, path, handler):
+        self.handlers[path] = handler
+
+    def requests_to(self, path):
+        with self.lock:
+            return [r for r in self.requests if r.path == path]
+
+    def start(self):
+        self.running = True
+        self.thread.start()
+
+    def stop(self):
+        self.running = False
+        self.thread.join()
+        self.sock.close()
+
+    def _respond(self, request):
+        handler = self.handlers.get(request.path)
+        if handler is None:
+            return CODE_CHANGED, b'', []
+
+        return handler(request)
+
+    def _serve(self):
+        while self.running:
+            try:
+                data, addr = self.sock.recvfrom(2048)
+            except socket.timeout:
+                continue
+
+            try:
+                request = parse(data)
+            except (ValueError, IndexError, struct.error):
+                continue
+
+            # ACKs of separate responses and resets need no answer.
+            if request.code == CODE_EMPTY or (request.code >> 5) != 0:
+                continue
+
+            with self.lock:
+                self.requests.append(request)
+
+            code, payload, options = self._respond(request)
+            if request.type == TYPE_CON:
+                response = Message(TYPE_ACK, code, request.message_id, request.token)
+            else:
+                response = Message(TYPE_NON, code, random.getrandbits(16), request.token)
+            response.options = list(options)
+            if payload:
+                response.options.append((OPTION_CONTENT_FORMAT,
+                                         uint_option(CONTENT_FORMAT_TEXT_PLAIN)))
+                response.payload = payload
+
+            self.sock.sendto(encode(response), addr)
+
+
+def resolver_handler(request):
+    code, payload = resolve(request.payload)
+    return code, payload, []
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=5683)
+    parser.add_argument('--resolver', default='cell-location',
+                        help='resource of the cell location resolver')
+    args = parser.parse_args()
+
+    server = CoapServer(args.host, args.port)
+    server.resource(args.resolver, resolver_handler)
+    server.start()
+    print(f'CoAP server on {args.host}:{args.port}, resolver on /{args.resolver}')
+
+    seen = 0
+    try:
+        while True:
+            server.thread.join(1.0)
+            with server.lock:
+                new, seen = server.requests[seen:], len(server.requests)
+            for r in new:
+                print(f'{r.path} {r.queries} {len(r.payload)} bytes')
+    except KeyboardInterrupt:
+        server.stop()
+
+
+if __name__ == '__main__':
+    main()
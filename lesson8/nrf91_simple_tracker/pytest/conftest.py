@@ -0,0 +1,19 @@
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+import pytest
+
+from coap_server import CoapServer, resolver_handler
+
+
+@pytest.fixture(scope='session')
+def coap_server():
+    """Server of the native_sim scenarios in sample.yaml, started before the tracker."""
+    server = CoapServer('127.0.0.1', 5683)
+    server.resource('cell-location', resolver_handler)
+    server.start()
+    yield server
+    server.stop()
@@ -0,0 +1,32 @@
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+from twister_harness import DeviceAdapter
+
+# Serving cell of the modem simulation, and its position in coap_server.CELLS.
+SERVING_CELL = ['242', '1', '2939', '20174082']
+POSITION = r'Coarse position: 63\.430500,10\.395100 \(1500 m\)'
+
+
+def test_cell_fallback(coap_server, dut: DeviceAdapter):
+    """Two GNSS timeouts in the same cell: the first one asks the resolver,
+    the second one is answered from the cache."""
+    dut.readlines_until(regex='falling back to the cell location', timeout=120)
+    dut.readlines_until(regex=POSITION, timeout=60)
+
+    lookups = coap_server.requests_to('cell-location')
+    assert len(lookups) == 1
+    serving = lookups[0].payload.decode().splitlines()[0].split(',')
+    assert serving[:4] == SERVING_CELL
+
+    dut.readlines_until(regex='falling back to the cell location', timeout=120)
+    dut.readlines_until(regex='found in the location cache', timeout=60)
+    dut.readlines_until(regex=POSITION, timeout=10)
+
+    assert len(coap_server.requests_to('cell-location')) == 1
+
+    # The first coarse fix was uploaded.
+    assert len(coap_server.requests_to('echo')) >= 1
@@ -0,0 +1,52 @@
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+import logging
+import re
+from pathlib import Path
+
+from twister_harness import DeviceAdapter
+
+logger = logging.getLogger(__name__)
+
+TAIL = r'RRC tail after the upload: last (\d+) ms'
+# Time from the response to the end of the session, and timer jitter.
+TOLERANCE_MS = 250
+# Longest RRC tail expected after a Release Assistance Indication.
+RAI_TAIL_MAX_MS = 1000
+
+
+def kconfig(build_dir, name):
+    """Value of CONFIG_<name> in the build, None if it is not set."""
+    config = (Path(build_dir) / 'zephyr' / '.config').read_text()
+    match = re.search(rf'^CONFIG_{name}=(.*)$', config, re.M)
+    return match.group(1) if match else None
+
+
+def test_rrc_tail(request, coap_server, dut: DeviceAdapter):
+    """Time from the end of an upload to the RRC release.
+
+    With TRACKER_RAI the last request tells the network that only its
+    response follows, and the connection is released right after it.
+    Without, it is held until the RRC inactivity timer of the network
+    expires.
+    """
+    build_dir = request.config.getoption('--build-dir')
+    rai = kconfig(build_dir, 'TRACKER_RAI') == 'y'
+    inactivity_ms = int(kconfig(build_dir, 'MODEM_SIM_RRC_INACTIVITY_TIME_MS'))
+
+    # The tail of an upload is logged with the statistics of the next one.
+    lines = dut.readlines_until(regex=TAIL, timeout=180)
+    tail_ms = int(re.search(TAIL, lines[-1]).group(1))
+    logger.info('RRC tail %s RAI: %d ms', 'with' if rai else 'without', tail_ms)
+
+    assert len(coap_server.requests_to('echo')) >= 1
+    if rai:
+        assert tail_ms < RAI_TAIL_MAX_MS
+    else:
+        # The inactivity timer runs from the response, the tail from the
+        # end of the session a moment later.
+        assert inactivity_ms - TOLERANCE_MS <= tail_ms <= inactivity_ms + TOLERANCE_MS
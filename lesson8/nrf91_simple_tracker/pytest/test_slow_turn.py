@@ -0,0 +1,21 @@
+#
+# Copyright (c) 2023 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+#
+
+from twister_harness import DeviceAdapter
+
+
+def test_slow_turn(coap_server, dut: DeviceAdapter):
+    """A turn below the motion speed threshold shortens the fix interval.
+
+    slow_turn.csv walks north at 0.3 m/s, which is not moving, so the
+    interval backs off. The turn to the east must bring it back to
+    CONFIG_TRACKER_FIX_INTERVAL_MIN (10 s in the scenario).
+    """
+    dut.readlines_until(regex=r'Speed 0\.3 m/s, heading 0 deg: fix interval 20 s',
+                        timeout=120)
+    lines = dut.readlines_until(regex=r'Speed 0\.3 m/s, heading 90 deg', timeout=120)
+
+    assert 'heading 90 deg (turning): fix interval 10 s' in lines[-1]
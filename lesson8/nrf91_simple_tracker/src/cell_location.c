@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <date_time.h>
+
+#include "cell_location.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+BUILD_ASSERT(sizeof(CONFIG_TRACKER_CELL_RESOLVER_RESOURCE) > 1,
+	     "The cell fallback needs the resource of a location resolver");
+
+/* Neighbor cells kept from a measurement and sent to the resolver. */
+#define CELL_LOCATION_NEIGHBORS_MAX 8
+
+struct cell_cache_entry {
+	uint32_t mcc;
+	uint32_t mnc;
+	uint32_t tac;
+	uint32_t id;
+	double latitude;
+	double longitude;
+	float accuracy;
+	/* Value of use_counter at the last hit, 0 if the entry is unused. */
+	uint32_t last_used;
+};
+
+static struct cell_cache_entry cache[CONFIG_TRACKER_CELL_CACHE_SIZE];
+static uint32_t use_counter;
+
+/* Last measurement, written by the LTE handler and read by the main thread. */
+static struct lte_lc_cell current_cell;
+static struct lte_lc_ncell neighbors[CELL_LOCATION_NEIGHBORS_MAX];
+static uint8_t neighbor_count;
+static K_SEM_DEFINE(measurement_sem, 0, 1);
+
+void cell_location_measurement_set(const struct lte_lc_cells_info *cells)
+{
+	current_cell = cells->current_cell;
+	neighbor_count = MIN(cells->ncells_count, ARRAY_SIZE(neighbors));
+	if (neighbor_count > 0) {
+		memcpy(neighbors, cells->neighbor_cells, neighbor_count * sizeof(neighbors[0]));
+	}
+
+	k_sem_give(&measurement_sem);
+}
+
+int cell_location_measure(k_timeout_t timeout)
+{
+	int err;
+
+	k_sem_reset(&measurement_sem);
+
+	err = lte_lc_neighbor_cell_measurement(LTE_LC_NEIGHBOR_SEARCH_TYPE_DEFAULT);
+	if (err) {
+		LOG_ERR("Failed to start neighbor cell measurement: %d", err);
+		return err;
+	}
+
+	if (k_sem_take(&measurement_sem, timeout) != 0) {
+		LOG_ERR("Neighbor cell measurement timed out");
+		(void)lte_lc_neighbor_cell_measurement_cancel();
+		return -ETIMEDOUT;
+	}
+
+	if (current_cell.id == LTE_LC_CELL_EUTRAN_ID_INVALID) {
+		LOG_WRN("No serving cell found");
+		return -ENOENT;
+	}
+
+	LOG_INF("Serving cell %u (TAC %u, %u-%u), %u neighbor cells",
+		current_cell.id, current_cell.tac, current_cell.mcc, current_cell.mnc,
+		neighbor_count);
+
+	return 0;
+}
+
+/**@brief Fill a coarse fix record, timestamped with the network time if known. */
+static void record_fill(struct fix_record *record, double latitude, double longitude,
+			float accuracy)
+{
+	int64_t now_ms;
+	time_t now;
+	struct tm tm;
+
+	*record = (struct fix_record){
+		.latitude = latitude,
+		.longitude = longitude,
+		.accuracy = accuracy,
+		.type = FIX_TYPE_CELL,
+	};
+
+	/* Left at zero when the network time is not known yet. */
+	if (date_time_now(&now_ms) != 0) {
+		return;
+	}
+
+	now = now_ms / MSEC_PER_SEC;
+	if (gmtime_r(&now, &tm) != NULL) {
+		record->datetime.year = tm.tm_year + 1900;
+		record->datetime.month = tm.tm_mon + 1;
+		record->datetime.day = tm.tm_mday;
+		record->datetime.hour = tm.tm_hour;
+		record->datetime.minute = tm.tm_min;
+		record->datetime.seconds = tm.tm_sec;
+	}
+}
+
+static bool entry_matches(const struct cell_cache_entry *entry)
+{
+	return (entry->last_used != 0) &&
+	       (entry->id == current_cell.id) && (entry->tac == current_cell.tac) &&
+	       (entry->mcc == current_cell.mcc) && (entry->mnc == current_cell.mnc);
+}
+
+int cell_location_lookup(struct fix_record *record)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(cache); i++) {
+		if (entry_matches(&cache[i])) {
+			cache[i].last_used = ++use_counter;
+			record_fill(record, cache[i].latitude, cache[i].longitude,
+				    cache[i].accuracy);
+			LOG_INF("Cell %u found in the location cache", current_cell.id);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+int cell_location_request_format(char *buf, size_t len)
+{
+	int ret;
+	size_t offset;
+
+	ret = snprintf(buf, len, "%u,%u,%u,%u,%d\n",
+		       current_cell.mcc, current_cell.mnc, current_cell.tac,
+		       current_cell.id, current_cell.rsrp);
+	if ((ret < 0) || ((size_t)ret >= len)) {
+		return -ENOMEM;
+	}
+	offset = ret;
+
+	for (size_t i = 0; i < neighbor_count; i++) {
+		ret = snprintf(buf + offset, len - offset, "%u,%u,%d\n",
+			       neighbors[i].earfcn, neighbors[i].phys_cell_id,
+			       neighbors[i].rsrp);
+		if ((ret < 0) || ((size_t)ret >= (len - offset))) {
+			/* Send the neighbors that fit. */
+			break;
+		}
+		offset += ret;
+	}
+
+	return offset;
+}
+
+/**@brief Cache the position of the current cell, replacing the least recently used entry. */
+static void cache_store(double latitude, double longitude, float accuracy)
+{
+	struct cell_cache_entry *entry = &cache[0];
+
+	for (size_t i = 0; i < ARRAY_SIZE(cache); i++) {
+		if (entry_matches(&cache[i])) {
+			entry = &cache[i];
+			break;
+		}
+		if (cache[i].last_used < entry->last_used) {
+			entry = &cache[i];
+		}
+	}
+
+	*entry = (struct cell_cache_entry){
+		.mcc = current_cell.mcc,
+		.mnc = current_cell.mnc,
+		.tac = current_cell.tac,
+		.id = current_cell.id,
+		.latitude = latitude,
+		.longitude = longitude,
+		.accuracy = accuracy,
+		.last_used = ++use_counter,
+	};
+}
+
+int cell_location_response_parse(const uint8_t *payload, uint16_t len,
+				 struct fix_record *record)
+{
+	char buf[64];
+	char *next;
+	double latitude, longitude, accuracy;
+
+	if ((len == 0) || (len >= sizeof(buf))) {
+		return -EBADMSG;
+	}
+	memcpy(buf, payload, len);
+	buf[len] = '\0';
+
+	latitude = strtod(buf, &next);
+	if (*next++ != ',') {
+		return -EBADMSG;
+	}
+	longitude = strtod(next, &next);
+	if (*next++ != ',') {
+		return -EBADMSG;
+	}
+	accuracy = strtod(next, &next);
+
+	if ((latitude < -90.0) || (latitude > 90.0) ||
+	    (longitude < -180.0) || (longitude > 180.0) || (accuracy <= 0.0)) {
+		return -EBADMSG;
+	}
+
+	cache_store(latitude, longitude, accuracy);
+	record_fill(record, latitude, longitude, accuracy);
+
+	return 0;
+}
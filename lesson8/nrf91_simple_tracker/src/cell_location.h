@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _CELL_LOCATION_H_
+#define _CELL_LOCATION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <modem/lte_lc.h>
+
+#include "fix_buffer.h"
+
+/**@brief Store the result of a neighbor cell measurement.
+ *
+ * Called from the LTE event handler on LTE_LC_EVT_NEIGHBOR_CELL_MEAS.
+ * The measurement is copied, as the event data is only valid in the handler.
+ */
+void cell_location_measurement_set(const struct lte_lc_cells_info *cells);
+
+/**@brief Measure the serving and neighbor cells.
+ *
+ * LTE must be active. Blocks until the measurement is reported or
+ * @p timeout expires.
+ *
+ * @return 0 on success, -ENOENT if no serving cell was found, -ETIMEDOUT
+ *	   if the measurement was not reported in time, or a negative error
+ *	   code from lte_lc.
+ */
+int cell_location_measure(k_timeout_t timeout);
+
+/**@brief Look up the position of the last measured serving cell in the cache.
+ *
+ * @return 0 and a coarse fix in @p record on a cache hit, -ENOENT otherwise.
+ */
+int cell_location_lookup(struct fix_record *record);
+
+/**@brief Format the last measurement as a location resolver request payload.
+ *
+ * The first line holds the serving cell as "mcc,mnc,tac,cell_id,rsrp",
+ * followed by one "earfcn,pci,rsrp" line per neighbor cell.
+ *
+ * @return Length of the payload, or a negative error code.
+ */
+int cell_location_request_format(char *buf, size_t len);
+
+/**@brief Handle a location resolver response of the form "lat,lon,accuracy".
+ *
+ * The position is cached for the last measured serving cell.
+ *
+ * @return 0 and a coarse fix in @p record on success, -EBADMSG if the
+ *	   response could not be parsed.
+ */
+int cell_location_response_parse(const uint8_t *payload, uint16_t len,
+				 struct fix_record *record);
+
+#endif /* _CELL_LOCATION_H_ */
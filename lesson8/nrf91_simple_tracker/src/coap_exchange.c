@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/random/rand32.h>
+
+#include "coap_exchange.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define APP_COAP_VERSION 1
+
+static coap_exchange_request_cb_t request_cb;
+static uint32_t total_retransmissions;
+/* CoAP bytes sent and received, without DTLS and IP overhead. */
+static uint32_t total_bytes;
+
+static void exchange_complete(struct coap_exchange *ex, enum coap_exchange_result result,
+			      const struct coap_packet *response)
+{
+	ex->active = false;
+
+	LOG_INF("CoAP exchange 0x%04x done: result %d, %u retransmissions, %lld ms",
+		ex->id, result, ex->retransmissions, k_uptime_get() - ex->start);
+
+	if (ex->cb) {
+		ex->cb(result, response, ex->user_data);
+	}
+}
+
+#if defined(CONFIG_TRACKER_RAI)
+/* Release Assistance Indication for the next send() on the socket. */
+static void exchange_rai_set(struct coap_exchange *ex, int rai)
+{
+	if (setsockopt(ex->sock, SOL_SOCKET, SO_RAI, &rai, sizeof(rai)) < 0) {
+		LOG_WRN("Failed to set RAI, %d", errno);
+	}
+}
+#endif
+
+static int exchange_transmit(struct coap_exchange *ex)
+{
+#if defined(CONFIG_TRACKER_RAI)
+	/* Applies to the next send only, so it is set for every retransmission. */
+	if (ex->last) {
+		exchange_rai_set(ex, RAI_ONE_RESP);
+	}
+#endif
+	if (send(ex->sock, ex->request, ex->request_len, 0) < 0) {
+		LOG_ERR("Failed to send CoAP request, %d", errno);
+		return -errno;
+	}
+	total_bytes += ex->request_len;
+
+	return 0;
+}
+
+/* Acknowledge a separate confirmable response. */
+static void exchange_ack_send(struct coap_exchange *ex, const struct coap_packet *response)
+{
+	struct coap_packet ack;
+	uint8_t buf[4];
+
+	if (coap_packet_init(&ack, buf, sizeof(buf), APP_COAP_VERSION, COAP_TYPE_ACK,
+			     0, NULL, COAP_CODE_EMPTY, coap_header_get_id(response)) < 0) {
+		return;
+	}
+
+#if defined(CONFIG_TRACKER_RAI)
+	if (ex->last) {
+		exchange_rai_set(ex, RAI_LAST);
+	}
+#endif
+
+	if (send(ex->sock, ack.data, ack.offset, 0) > 0) {
+		total_bytes += ack.offset;
+	}
+}
+
+static bool is_request(const struct coap_packet *packet)
+{
+	uint8_t code = coap_header_get_code(packet);
+
+	/* Method codes are in class 0, next to the empty message. */
+	return (code != COAP_CODE_EMPTY) && ((code >> 5) == 0);
+}
+
+static void request_handle(int sock, const struct coap_packet *request)
+{
+	struct coap_packet response;
+
+	if ((request_cb == NULL) || (request_cb(request, &response) != 0)) {
+		return;
+	}
+
+	if (send(sock, response.data, response.offset, 0) < 0) {
+		LOG_ERR("Failed to send CoAP response, %d", errno);
+		return;
+	}
+	total_bytes += response.offset;
+}
+
+static bool token_matches(const struct coap_exchange *ex, const struct coap_packet *packet)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len = coap_header_get_token(packet, token);
+
+	return (token_len == ex->token_len) && (memcmp(token, ex->token, token_len) == 0);
+}
+
+/* Handle one incoming message. Returns true if it completed the exchange. */
+static bool exchange_receive(struct coap_exchange *ex, int received)
+{
+	struct coap_packet reply;
+	uint8_t type;
+	uint8_t code;
+	int err;
+
+	err = coap_packet_parse(&reply, ex->rx_buf, received, NULL, 0);
+	if (err < 0) {
+		LOG_ERR("Malformed response received: %d", err);
+		return false;
+	}
+
+	if (is_request(&reply)) {
+		request_handle(ex->sock, &reply);
+		return false;
+	}
+
+	type = coap_header_get_type(&reply);
+	code = coap_header_get_code(&reply);
+
+	if ((type == COAP_TYPE_ACK) || (type == COAP_TYPE_RESET)) {
+		if (coap_header_get_id(&reply) != ex->id) {
+			return false;
+		}
+
+		if (type == COAP_TYPE_RESET) {
+			exchange_complete(ex, COAP_EXCHANGE_RESET, NULL);
+			return true;
+		}
+
+		if (code == COAP_CODE_EMPTY) {
+			/* Separate response will follow, stop retransmitting. */
+			ex->acked = true;
+			return false;
+		}
+	}
+
+	if (!token_matches(ex, &reply)) {
+		LOG_WRN("Response with unexpected token ignored");
+		return false;
+	}
+
+	if (type == COAP_TYPE_CON) {
+		exchange_ack_send(ex, &reply);
+	}
+
+	exchange_complete(ex, COAP_EXCHANGE_RESPONSE, &reply);
+
+	return true;
+}
+
+int coap_exchange_start(struct coap_exchange *ex, int sock,
+			const struct coap_packet *request,
+			uint8_t *rx_buf, size_t rx_buf_len, bool last,
+			coap_exchange_cb_t cb, void *user_data)
+{
+	int64_t now = k_uptime_get();
+
+	ex->sock = sock;
+	ex->request = request->data;
+	ex->request_len = request->offset;
+	ex->id = coap_header_get_id(request);
+	ex->token_len = coap_header_get_token(request, ex->token);
+	ex->rx_buf = rx_buf;
+	ex->rx_buf_len = rx_buf_len;
+	ex->cb = cb;
+	ex->user_data = user_data;
+	ex->retransmissions = 0;
+	ex->acked = false;
+	ex->last = last;
+
+	/* Initial timeout between ACK_TIMEOUT and ACK_TIMEOUT * ACK_RANDOM_FACTOR (1.5). */
+	ex->timeout = CONFIG_COAP_INIT_ACK_TIMEOUT_MS +
+		      sys_rand32_get() % (CONFIG_COAP_INIT_ACK_TIMEOUT_MS / 2 + 1);
+	ex->start = now;
+	ex->next_tx = now + ex->timeout;
+	ex->deadline = now + CONFIG_TRACKER_COAP_EXCHANGE_DEADLINE;
+
+	ex->active = true;
+
+	return exchange_transmit(ex);
+}
+
+int coap_exchange_process(struct coap_exchange *ex)
+{
+	int64_t now;
+	int received;
+
+	if (!ex->active) {
+		return 0;
+	}
+
+	/* Everything that arrived, without waiting. */
+	while (true) {
+		received = recv(ex->sock, ex->rx_buf, ex->rx_buf_len, MSG_DONTWAIT);
+		if (received < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				break;
+			}
+			LOG_ERR("Error reading response: %d", errno);
+			exchange_complete(ex, COAP_EXCHANGE_ERROR, NULL);
+			return 0;
+		}
+
+		total_bytes += received;
+		if ((received > 0) && exchange_receive(ex, received)) {
+			return 0;
+		}
+	}
+
+	now = k_uptime_get();
+	if (now >= ex->deadline) {
+		exchange_complete(ex, COAP_EXCHANGE_TIMEOUT, NULL);
+		return 0;
+	}
+
+	if (!ex->acked && (now >= ex->next_tx)) {
+		if (ex->retransmissions >= CONFIG_TRACKER_COAP_MAX_RETRANSMIT) {
+			exchange_complete(ex, COAP_EXCHANGE_TIMEOUT, NULL);
+			return 0;
+		}
+
+		ex->retransmissions++;
+		total_retransmissions++;
+		ex->timeout *= 2;
+		ex->next_tx = now + ex->timeout;
+		LOG_WRN("CoAP request 0x%04x retransmission %u", ex->id, ex->retransmissions);
+
+		if (exchange_transmit(ex) != 0) {
+			exchange_complete(ex, COAP_EXCHANGE_ERROR, NULL);
+			return 0;
+		}
+	}
+
+	return -EINPROGRESS;
+}
+
+int coap_exchange_next_timeout(const struct coap_exchange *ex)
+{
+	int64_t wake;
+
+	if (!ex->active) {
+		return 0;
+	}
+
+	wake = ex->acked ? ex->deadline : MIN(ex->next_tx, ex->deadline);
+
+	return (int)MAX(wake - k_uptime_get(), 0);
+}
+
+void coap_exchange_request_handler_set(coap_exchange_request_cb_t cb)
+{
+	request_cb = cb;
+}
+
+int coap_exchange_response_init(struct coap_packet *response, uint8_t *buf, size_t len,
+				const struct coap_packet *request, uint8_t code)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len = coap_header_get_token(request, token);
+	bool con = (coap_header_get_type(request) == COAP_TYPE_CON);
+
+	return coap_packet_init(response, buf, len, APP_COAP_VERSION,
+				con ? COAP_TYPE_ACK : COAP_TYPE_NON_CON, token_len, token, code,
+				con ? coap_header_get_id(request) : coap_next_id());
+}
+
+int coap_exchange_listen(int sock, uint8_t *rx_buf, size_t rx_buf_len, int32_t idle_ms)
+{
+	struct pollfd fds = {
+		.fd = sock,
+		.events = POLLIN,
+	};
+	struct coap_packet request;
+	int served = 0;
+	int received;
+	int err;
+
+	while (true) {
+		err = poll(&fds, 1, idle_ms);
+		if (err < 0) {
+			LOG_ERR("poll() failed: %d", errno);
+			return -errno;
+		}
+
+		if (err == 0) {
+			return served;
+		}
+
+		if (fds.revents & (POLLERR | POLLNVAL | POLLHUP)) {
+			LOG_ERR("Socket error, revents 0x%x", fds.revents);
+			return -EIO;
+		}
+
+		received = recv(sock, rx_buf, rx_buf_len, MSG_DONTWAIT);
+		if (received < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				continue;
+			}
+			LOG_ERR("Error reading request: %d", errno);
+			return -errno;
+		}
+		total_bytes += received;
+
+		/* Late responses of finished exchanges are dropped. */
+		if ((received > 0) && (coap_packet_parse(&request, rx_buf, received, NULL, 0) == 0) &&
+		    is_request(&request)) {
+			request_handle(sock, &request);
+			served++;
+		}
+	}
+}
+
+uint32_t coap_exchange_retransmissions(void)
+{
+	return total_retransmissions;
+}
+
+uint32_t coap_exchange_bytes(void)
+{
+	return total_bytes;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _COAP_EXCHANGE_H_
+#define _COAP_EXCHANGE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/net/coap.h>
+
+/**@brief Confirmable CoAP request/response exchange.
+ *
+ * The request is retransmitted with the RFC 7252 exponential back-off
+ * (initial timeout CONFIG_COAP_INIT_ACK_TIMEOUT_MS, randomized by up to 50%,
+ * doubled on every retransmission, CONFIG_TRACKER_COAP_MAX_RETRANSMIT
+ * retransmissions). The exchange ends when the response arrives, when the
+ * server resets it, or at the latest after CONFIG_TRACKER_COAP_EXCHANGE_DEADLINE
+ * milliseconds, and the completion callback is called.
+ *
+ * The last exchange before the socket is closed is marked with a Release
+ * Assistance Indication (CONFIG_TRACKER_RAI): the request tells the network
+ * that only one response is expected, and the acknowledgement of a separate
+ * response that no more data follows.
+ */
+
+enum coap_exchange_result {
+	/* Response received, piggybacked or separate. */
+	COAP_EXCHANGE_RESPONSE,
+	/* No response before the deadline or after the last retransmission. */
+	COAP_EXCHANGE_TIMEOUT,
+	/* The server answered with a reset message. */
+	COAP_EXCHANGE_RESET,
+	/* Socket error. */
+	COAP_EXCHANGE_ERROR,
+};
+
+/**@brief Completion callback. @p response is only valid for COAP_EXCHANGE_RESPONSE. */
+typedef void (*coap_exchange_cb_t)(enum coap_exchange_result result,
+				   const struct coap_packet *response,
+				   void *user_data);
+
+struct coap_exchange {
+	int sock;
+	/* Request, kept for retransmissions. */
+	const uint8_t *request;
+	uint16_t request_len;
+	uint16_t id;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t token_len;
+	/* Buffer for incoming messages. */
+	uint8_t *rx_buf;
+	size_t rx_buf_len;
+	/* Uptime (ms) of the start, the next retransmission and the deadline. */
+	int64_t start;
+	int64_t next_tx;
+	int64_t deadline;
+	uint32_t timeout;
+	uint8_t retransmissions;
+	/* Empty ACK received, waiting for a separate response. */
+	bool acked;
+	/* Last exchange before the socket is closed. */
+	bool last;
+	bool active;
+	coap_exchange_cb_t cb;
+	void *user_data;
+};
+
+/**@brief Handler of requests received from the server.
+ *
+ * Builds the response in @p response, see coap_exchange_response_init().
+ *
+ * @return 0 to send the response, a negative error code to ignore the request.
+ */
+typedef int (*coap_exchange_request_cb_t)(const struct coap_packet *request,
+					  struct coap_packet *response);
+
+/**@brief Send a confirmable request and start the exchange.
+ *
+ * @param ex Exchange instance.
+ * @param sock Connected socket.
+ * @param request Encoded CON request. Its buffer must stay valid until the
+ *                exchange completes.
+ * @param rx_buf Buffer for incoming messages.
+ * @param rx_buf_len Size of @p rx_buf.
+ * @param last No other request follows on the socket.
+ * @param cb Completion callback.
+ * @param user_data Passed to @p cb.
+ */
+int coap_exchange_start(struct coap_exchange *ex, int sock,
+			const struct coap_packet *request,
+			uint8_t *rx_buf, size_t rx_buf_len, bool last,
+			coap_exchange_cb_t cb, void *user_data);
+
+/**@brief Process the exchange.
+ *
+ * Handles the messages already received on the socket, and the
+ * retransmission or deadline if it is due. Never waits: call it when the
+ * socket is readable, or when coap_exchange_next_timeout() has passed.
+ *
+ * @return -EINPROGRESS while the exchange is ongoing, 0 once it has
+ *         completed and the callback has been called.
+ */
+int coap_exchange_process(struct coap_exchange *ex);
+
+/**@brief Time (in milliseconds) until the next retransmission or the
+ * deadline of the exchange, 0 if it is due or the exchange has completed.
+ *
+ * The longest time to wait for the socket before calling
+ * coap_exchange_process() again.
+ */
+int coap_exchange_next_timeout(const struct coap_exchange *ex);
+
+/**@brief Set the handler of requests from the server.
+ *
+ * Requests are answered while an exchange waits for its response, and in
+ * coap_exchange_listen().
+ */
+void coap_exchange_request_handler_set(coap_exchange_request_cb_t cb);
+
+/**@brief Initialize the response to @p request.
+ *
+ * The response to a confirmable request is piggybacked on its ACK, a
+ * non-confirmable request gets a non-confirmable response.
+ */
+int coap_exchange_response_init(struct coap_packet *response, uint8_t *buf, size_t len,
+				const struct coap_packet *request, uint8_t code);
+
+/**@brief Answer requests from the server until none arrived for @p idle_ms.
+ *
+ * @return Number of requests answered, or a negative error code on a
+ *	   socket error.
+ */
+int coap_exchange_listen(int sock, uint8_t *rx_buf, size_t rx_buf_len, int32_t idle_ms);
+
+/**@brief Number of retransmissions done by all exchanges so far. */
+uint32_t coap_exchange_retransmissions(void);
+
+/**@brief Number of CoAP bytes sent and received by all exchanges so far. */
+uint32_t coap_exchange_bytes(void);
+
+#endif /* _COAP_EXCHANGE_H_ */
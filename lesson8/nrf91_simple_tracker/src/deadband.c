@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "deadband.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+static bool have_reference;
+static double ref_latitude;
+static double ref_longitude;
+static int64_t ref_time;
+
+static uint32_t suppressed;
+static uint32_t keep_alives;
+
+/* Equirectangular approximation, accurate enough for dead-band distances. */
+static double distance_m(double lat1, double lon1, double lat2, double lon2)
+{
+	double x = (lon2 - lon1) * DEG_TO_RAD * cos((lat1 + lat2) / 2.0 * DEG_TO_RAD);
+	double y = (lat2 - lat1) * DEG_TO_RAD;
+
+	return sqrt(x * x + y * y) * EARTH_RADIUS_M;
+}
+
+bool deadband_accept(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+	int64_t now = k_uptime_get();
+	double distance;
+
+	if (have_reference) {
+		distance = distance_m(ref_latitude, ref_longitude, pvt->latitude, pvt->longitude);
+
+		if (distance < CONFIG_TRACKER_DEADBAND_DISTANCE) {
+			if ((now - ref_time) < (int64_t)CONFIG_TRACKER_DEADBAND_MAX_SILENCE * MSEC_PER_SEC) {
+				suppressed++;
+				LOG_INF("Fix suppressed, moved %.1f m (%u suppressed)", distance,
+					suppressed);
+				return false;
+			}
+
+			keep_alives++;
+			LOG_INF("Keep-alive fix after %lld s (%u keep-alives)",
+				(now - ref_time) / MSEC_PER_SEC, keep_alives);
+		}
+	}
+
+	have_reference = true;
+	ref_latitude = pvt->latitude;
+	ref_longitude = pvt->longitude;
+	ref_time = now;
+
+	return true;
+}
+
+uint32_t deadband_suppressed(void)
+{
+	return suppressed;
+}
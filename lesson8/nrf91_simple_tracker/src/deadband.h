@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _DEADBAND_H_
+#define _DEADBAND_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <nrf_modem_gnss.h>
+
+/**@brief Check whether a fix should be uploaded.
+ *
+ * A fix closer than CONFIG_TRACKER_DEADBAND_DISTANCE meters to the last
+ * accepted fix is suppressed, unless CONFIG_TRACKER_DEADBAND_MAX_SILENCE
+ * seconds have passed since the last accepted fix, in which case it is
+ * accepted as a keep-alive. Accepted fixes become the new reference.
+ *
+ * @return true if the fix should be uploaded.
+ */
+bool deadband_accept(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
+/**@brief Number of fixes suppressed so far. */
+uint32_t deadband_suppressed(void);
+
+#endif /* _DEADBAND_H_ */
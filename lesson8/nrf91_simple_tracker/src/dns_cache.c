@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+
+#include "dns_cache.h"
+#include "storage.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+static const char *cached_hostname;
+static struct in_addr cached_addr;
+static bool valid;
+/* Set when the address is suspected to be wrong, e.g. after a failed send. */
+static bool suspect;
+static int64_t expires_at;
+static K_MUTEX_DEFINE(cache_lock);
+
+static struct {
+	uint32_t hits;
+	uint32_t lookups;
+	uint32_t failures;
+} stats;
+
+static int resolve(struct in_addr *addr)
+{
+	int err;
+	struct addrinfo *result;
+	struct addrinfo hints = {
+		.ai_family = AF_INET,
+		.ai_socktype = SOCK_DGRAM
+	};
+
+	err = getaddrinfo(cached_hostname, NULL, &hints, &result);
+	if (err != 0) {
+		LOG_ERR("ERROR: getaddrinfo failed %d\n", err);
+		return -EIO;
+	}
+
+	if (result == NULL) {
+		LOG_ERR("ERROR: Address not found\n");
+		return -ENOENT;
+	}
+
+	*addr = ((struct sockaddr_in *)result->ai_addr)->sin_addr;
+
+	freeaddrinfo(result);
+
+	return 0;
+}
+
+/* Resolve and update the cache. The lookup itself is done without the lock. */
+static int refresh(void)
+{
+	struct in_addr addr;
+	char ipv4_addr[NET_IPV4_ADDR_LEN];
+	bool changed;
+	int err;
+
+	err = resolve(&addr);
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	stats.lookups++;
+	if (err) {
+		stats.failures++;
+		k_mutex_unlock(&cache_lock);
+		return err;
+	}
+	changed = !valid || (addr.s_addr != cached_addr.s_addr);
+	cached_addr = addr;
+	valid = true;
+	suspect = false;
+	expires_at = k_uptime_get() + (int64_t)CONFIG_TRACKER_DNS_CACHE_TTL * MSEC_PER_SEC;
+	k_mutex_unlock(&cache_lock);
+
+	inet_ntop(AF_INET, &addr, ipv4_addr, sizeof(ipv4_addr));
+	LOG_INF("IPv4 Address found %s\n", ipv4_addr);
+
+	/* Only write flash when the address has changed. */
+	if (changed && (storage_fs() != NULL)) {
+		(void)nvs_write(storage_fs(), STORAGE_ID_DNS_ADDRESS, &addr, sizeof(addr));
+	}
+
+	return 0;
+}
+
+int dns_cache_init(const char *hostname)
+{
+	ssize_t ret;
+
+	cached_hostname = hostname;
+
+	if (storage_fs() == NULL) {
+		return -ENODEV;
+	}
+
+	ret = nvs_read(storage_fs(), STORAGE_ID_DNS_ADDRESS, &cached_addr, sizeof(cached_addr));
+	if (ret != sizeof(cached_addr)) {
+		return -ENOENT;
+	}
+
+	/* The time since the address was stored is unknown, start a new TTL. */
+	valid = true;
+	expires_at = k_uptime_get() + (int64_t)CONFIG_TRACKER_DNS_CACHE_TTL * MSEC_PER_SEC;
+	LOG_INF("Using persisted address of %s", hostname);
+
+	return 0;
+}
+
+int dns_cache_get(struct in_addr *addr)
+{
+	bool usable;
+	bool expired;
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	usable = valid && !suspect;
+	expired = k_uptime_get() >= expires_at;
+	k_mutex_unlock(&cache_lock);
+
+	/* The caller is about to send, so the link is up for the lookup.
+	 * Fall back to the old address if the lookup fails.
+	 */
+	if ((!usable || expired) && (refresh() != 0)) {
+		if (!valid) {
+			return -EIO;
+		}
+		LOG_WRN("DNS refresh failed, keeping the cached address");
+	}
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	*addr = cached_addr;
+	if (usable && !expired) {
+		stats.hits++;
+	}
+	LOG_DBG("DNS cache: %u hits, %u lookups, %u failed", stats.hits, stats.lookups,
+		stats.failures);
+	k_mutex_unlock(&cache_lock);
+
+	return 0;
+}
+
+void dns_cache_invalidate(void)
+{
+	k_mutex_lock(&cache_lock, K_FOREVER);
+	suspect = true;
+	k_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _DNS_CACHE_H_
+#define _DNS_CACHE_H_
+
+#include <zephyr/net/socket.h>
+
+/**@brief Single-entry resolver cache for the server hostname.
+ *
+ * The last resolved IPv4 address is kept in flash, so a reboot does not
+ * need a DNS lookup. The offloaded resolver does not report the record TTL,
+ * so an entry is considered fresh for CONFIG_TRACKER_DNS_CACHE_TTL seconds.
+ * An expired entry is looked up again on the next dns_cache_get(), which is
+ * called right before an upload while the link is up. If that lookup fails
+ * the expired entry is still returned.
+ */
+
+/**@brief Load the persisted address of @p hostname, if any. */
+int dns_cache_init(const char *hostname);
+
+/**@brief Get the address of the hostname.
+ *
+ * Resolves only when there is no usable entry, that is on the very first
+ * lookup, after dns_cache_invalidate() or when the entry has expired.
+ */
+int dns_cache_get(struct in_addr *addr);
+
+/**@brief Mark the entry as unusable, for example after a failed send.
+ *
+ * The next dns_cache_get() resolves the hostname again. If that lookup
+ * fails the old address is still used.
+ */
+void dns_cache_invalidate(void);
+
+#endif /* _DNS_CACHE_H_ */
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "energy.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define MS_PER_HOUR (60 * 60 * MSEC_PER_SEC)
+
+enum lte_state {
+	LTE_OFF,
+	LTE_SEARCH,
+	LTE_CONNECTED,
+	LTE_IDLE,
+	LTE_IDLE_EDRX,
+	LTE_PSM,
+	LTE_STATE_COUNT
+};
+
+static const char *const lte_state_names[] = {
+	"off", "search", "connected", "idle", "eDRX", "PSM"
+};
+
+/* Current drawn on top of CONFIG_TRACKER_ENERGY_SLEEP_CURRENT, in uA. */
+static const uint32_t gnss_current[] = {
+	[ENERGY_GNSS_OFF] = 0,
+	[ENERGY_GNSS_SEARCH] = CONFIG_TRACKER_ENERGY_GNSS_CURRENT,
+	[ENERGY_GNSS_SLEEP] = 0,
+};
+
+static const uint32_t lte_current[] = {
+	[LTE_OFF] = 0,
+	[LTE_SEARCH] = CONFIG_TRACKER_ENERGY_LTE_SEARCH_CURRENT,
+	[LTE_CONNECTED] = CONFIG_TRACKER_ENERGY_RRC_CONNECTED_CURRENT,
+	[LTE_IDLE] = CONFIG_TRACKER_ENERGY_RRC_IDLE_CURRENT,
+	[LTE_IDLE_EDRX] = CONFIG_TRACKER_ENERGY_EDRX_IDLE_CURRENT,
+	[LTE_PSM] = 0,
+};
+
+/* Time spent in every state. */
+struct timeline {
+	int64_t ms;
+	int64_t gnss_ms[ENERGY_GNSS_STATE_COUNT];
+	int64_t lte_ms[LTE_STATE_COUNT];
+};
+
+/* Updated from the GNSS handler in interrupt context, and from the LTE handler. */
+static struct k_spinlock lock;
+static int64_t last_update;
+static enum energy_gnss_state gnss_state;
+static enum lte_state lte_state;
+/* LTE conditions the state is derived from. */
+static bool lte_active;
+static bool lte_registered;
+static bool rrc_connected;
+static bool edrx_granted;
+static bool psm_sleeping;
+
+static struct timeline cycle;
+static struct timeline total;
+/* Estimate of the last ended cycle. */
+static struct {
+	uint32_t ms;
+	uint32_t charge_uah;
+	uint32_t avg_ua;
+	uint32_t life_days;
+} last;
+
+/* Add the time since the last update to the current states. Called with the lock held. */
+static void advance(void)
+{
+	int64_t now = k_uptime_get();
+	int64_t elapsed = now - last_update;
+
+	cycle.ms += elapsed;
+	cycle.gnss_ms[gnss_state] += elapsed;
+	cycle.lte_ms[lte_state] += elapsed;
+	last_update = now;
+}
+
+static enum lte_state lte_state_get(void)
+{
+	if (!lte_active) {
+		return LTE_OFF;
+	} else if (rrc_connected) {
+		return LTE_CONNECTED;
+	} else if (!lte_registered) {
+		return LTE_SEARCH;
+	} else if (psm_sleeping) {
+		return LTE_PSM;
+	}
+
+	return edrx_granted ? LTE_IDLE_EDRX : LTE_IDLE;
+}
+
+/* Charge of @p t, in uA ms. */
+static uint64_t charge_get(const struct timeline *t)
+{
+	uint64_t charge = (uint64_t)t->ms * CONFIG_TRACKER_ENERGY_SLEEP_CURRENT;
+
+	for (size_t i = 0; i < ENERGY_GNSS_STATE_COUNT; i++) {
+		charge += (uint64_t)t->gnss_ms[i] * gnss_current[i];
+	}
+
+	for (size_t i = 0; i < LTE_STATE_COUNT; i++) {
+		charge += (uint64_t)t->lte_ms[i] * lte_current[i];
+	}
+
+	return charge;
+}
+
+void energy_gnss_state_set(enum energy_gnss_state state)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	advance();
+	gnss_state = state;
+	k_spin_unlock(&lock, key);
+}
+
+void energy_evt_handler(const struct lte_lc_evt *const evt)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	advance();
+
+	switch (evt->type) {
+	case LTE_LC_EVT_NW_REG_STATUS:
+		lte_registered = (evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME) ||
+				 (evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_ROAMING);
+		/* Not registered is also reported when LTE is deactivated. */
+		lte_active = lte_registered ||
+			     (evt->nw_reg_status == LTE_LC_NW_REG_SEARCHING) ||
+			     (evt->nw_reg_status == LTE_LC_NW_REG_REGISTRATION_DENIED);
+		if (!lte_active) {
+			/* No RRC release or PSM events follow the deactivation. */
+			rrc_connected = false;
+			psm_sleeping = false;
+		}
+		break;
+	case LTE_LC_EVT_RRC_UPDATE:
+		rrc_connected = (evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED);
+		break;
+	case LTE_LC_EVT_EDRX_UPDATE:
+		edrx_granted = (evt->edrx_cfg.edrx > 0.0f);
+		break;
+	case LTE_LC_EVT_MODEM_SLEEP_ENTER:
+		if (evt->modem_sleep.type == LTE_LC_MODEM_SLEEP_PSM) {
+			psm_sleeping = true;
+		}
+		break;
+	case LTE_LC_EVT_MODEM_SLEEP_EXIT:
+		if (evt->modem_sleep.type == LTE_LC_MODEM_SLEEP_PSM) {
+			psm_sleeping = false;
+		}
+		break;
+	default:
+		break;
+	}
+
+	lte_state = lte_state_get();
+	k_spin_unlock(&lock, key);
+}
+
+void energy_cycle_end(void)
+{
+	struct timeline ended;
+	uint64_t charge;
+	uint64_t total_charge;
+	uint64_t total_avg_ua;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	advance();
+	ended = cycle;
+	total.ms += cycle.ms;
+	for (size_t i = 0; i < ENERGY_GNSS_STATE_COUNT; i++) {
+		total.gnss_ms[i] += cycle.gnss_ms[i];
+	}
+	for (size_t i = 0; i < LTE_STATE_COUNT; i++) {
+		total.lte_ms[i] += cycle.lte_ms[i];
+	}
+	memset(&cycle, 0, sizeof(cycle));
+	k_spin_unlock(&lock, key);
+
+	if ((ended.ms == 0) || (total.ms == 0)) {
+		return;
+	}
+
+	charge = charge_get(&ended);
+	last.ms = ended.ms;
+	last.charge_uah = DIV_ROUND_CLOSEST(charge, MS_PER_HOUR);
+	last.avg_ua = charge / ended.ms;
+
+	total_charge = charge_get(&total);
+	total_avg_ua = MAX(total_charge / total.ms, 1);
+	last.life_days = MIN(((uint64_t)CONFIG_TRACKER_ENERGY_BATTERY_CAPACITY * 1000) /
+			     (total_avg_ua * 24), UINT32_MAX);
+
+	LOG_INF("Energy: %u uAh in %u s, avg %u uA, %u uAh since boot, battery life %u days",
+		last.charge_uah, last.ms / MSEC_PER_SEC, last.avg_ua,
+		(uint32_t)DIV_ROUND_CLOSEST(total_charge, MS_PER_HOUR), last.life_days);
+	LOG_INF("GNSS search %lld ms, sleep %lld ms",
+		ended.gnss_ms[ENERGY_GNSS_SEARCH], ended.gnss_ms[ENERGY_GNSS_SLEEP]);
+	for (size_t i = 0; i < LTE_STATE_COUNT; i++) {
+		if (ended.lte_ms[i] > 0) {
+			LOG_INF("LTE %s %lld ms, %u uAh", lte_state_names[i], ended.lte_ms[i],
+				(uint32_t)DIV_ROUND_CLOSEST((uint64_t)ended.lte_ms[i] *
+							    lte_current[i], MS_PER_HOUR));
+		}
+	}
+}
+
+int energy_query_format(char *buf, size_t size)
+{
+	int len;
+
+	len = snprintf(buf, size, "energy=%u,%u,%u",
+		       last.charge_uah, last.ms / MSEC_PER_SEC, last.life_days);
+	if ((len < 0) || (len >= size)) {
+		return -ENOMEM;
+	}
+
+	return len;
+}
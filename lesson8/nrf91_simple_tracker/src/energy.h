@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _ENERGY_H_
+#define _ENERGY_H_
+
+#include <stddef.h>
+#include <modem/lte_lc.h>
+
+/**@brief Energy estimate from the GNSS and LTE state timelines.
+ *
+ * The time GNSS spends searching, and the time LTE spends searching for the
+ * network, RRC connected, idle, idle with eDRX and in PSM, is taken from the
+ * GNSS and LTE events. Every state draws a configured current on top of the
+ * sleep current of the device, and the charge of a cycle is the sum of the
+ * state times weighted by their currents.
+ *
+ * A cycle runs from the start of one upload to the start of the next one, so
+ * it holds the RRC tail of the previous upload and the GNSS searches since.
+ * The projected battery life uses the average current since boot.
+ */
+
+/**@brief GNSS states, as seen by the GNSS event handler. */
+enum energy_gnss_state {
+	ENERGY_GNSS_OFF,
+	ENERGY_GNSS_SEARCH,
+	ENERGY_GNSS_SLEEP,
+	ENERGY_GNSS_STATE_COUNT
+};
+
+/**@brief Record a GNSS state change.
+ *
+ * Can be called from the GNSS event handler, in interrupt context.
+ */
+void energy_gnss_state_set(enum energy_gnss_state state);
+
+/**@brief Pass LTE link controller events to the energy estimate.
+ *
+ * Called from the LTE event handler.
+ */
+void energy_evt_handler(const struct lte_lc_evt *const evt);
+
+/**@brief End the current cycle and log its energy estimate. */
+void energy_cycle_end(void);
+
+/**@brief Format the estimate of the last cycle as CoAP URI query.
+ *
+ * The query is "energy=<uAh>,<s>,<days>": the charge of the last cycle in
+ * microampere-hours, its length in seconds and the projected battery life
+ * in days.
+ *
+ * @return Length of the query, or -ENOMEM if @p size is too small.
+ */
+int energy_query_format(char *buf, size_t size);
+
+#endif /* _ENERGY_H_ */
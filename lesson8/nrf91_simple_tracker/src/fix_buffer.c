@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "fix_buffer.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+BUILD_ASSERT(CONFIG_TRACKER_BATCH_HIGH_WATERMARK <= CONFIG_TRACKER_BATCH_CAPACITY,
+	     "High-water mark must not exceed the buffer capacity");
+
+static struct fix_record records[CONFIG_TRACKER_BATCH_CAPACITY];
+/* Index of the oldest fix. */
+static size_t head;
+static size_t count;
+static size_t stored_since_flush;
+static uint32_t overwritten;
+
+void fix_record_from_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt,
+			 struct fix_record *record)
+{
+	*record = (struct fix_record){
+		.latitude = pvt->latitude,
+		.longitude = pvt->longitude,
+		.altitude = pvt->altitude,
+		.accuracy = pvt->accuracy,
+		.speed = pvt->speed,
+		.heading = pvt->heading,
+		.datetime = pvt->datetime,
+		.type = FIX_TYPE_GNSS,
+	};
+}
+
+void fix_buffer_put(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+	struct fix_record record;
+
+	fix_record_from_pvt(pvt, &record);
+	fix_buffer_put_record(&record);
+}
+
+void fix_buffer_put_record(const struct fix_record *record)
+{
+	if (count == ARRAY_SIZE(records)) {
+		/* Buffer full, overwrite the oldest fix. */
+		head = (head + 1) % ARRAY_SIZE(records);
+		count--;
+		overwritten++;
+		LOG_WRN("Fix buffer full, oldest fix dropped (%u total)", overwritten);
+	}
+
+	records[(head + count) % ARRAY_SIZE(records)] = *record;
+	records[(head + count) % ARRAY_SIZE(records)].stored_at = k_uptime_get();
+
+	count++;
+	stored_since_flush++;
+}
+
+size_t fix_buffer_count(void)
+{
+	return count;
+}
+
+int fix_buffer_peek(size_t index, struct fix_record *record)
+{
+	if (index >= count) {
+		return -ENOENT;
+	}
+
+	*record = records[(head + index) % ARRAY_SIZE(records)];
+
+	return 0;
+}
+
+void fix_buffer_consume(size_t n)
+{
+	n = MIN(n, count);
+	head = (head + n) % ARRAY_SIZE(records);
+	count -= n;
+}
+
+bool fix_buffer_flush_due(void)
+{
+	if (count == 0) {
+		return false;
+	}
+
+	if (stored_since_flush >= CONFIG_TRACKER_BATCH_SIZE) {
+		LOG_INF("Flushing: %zu new fixes", stored_since_flush);
+		return true;
+	}
+
+	if (count >= CONFIG_TRACKER_BATCH_HIGH_WATERMARK) {
+		LOG_INF("Flushing: buffer high-water mark reached (%zu)", count);
+		return true;
+	}
+
+	if (K_TIMEOUT_EQ(fix_buffer_flush_timeout(), K_NO_WAIT)) {
+		LOG_INF("Flushing: oldest fix reached the maximum age");
+		return true;
+	}
+
+	return false;
+}
+
+void fix_buffer_flush_done(void)
+{
+	stored_since_flush = 0;
+}
+
+k_timeout_t fix_buffer_flush_timeout(void)
+{
+	int64_t age;
+
+	if ((count == 0) || (CONFIG_TRACKER_BATCH_MAX_AGE == 0)) {
+		return K_FOREVER;
+	}
+
+	age = k_uptime_get() - records[head].stored_at;
+	if (age >= (int64_t)CONFIG_TRACKER_BATCH_MAX_AGE * MSEC_PER_SEC) {
+		return K_NO_WAIT;
+	}
+
+	return K_MSEC((int64_t)CONFIG_TRACKER_BATCH_MAX_AGE * MSEC_PER_SEC - age);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _FIX_BUFFER_H_
+#define _FIX_BUFFER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+
+enum fix_type {
+	/* Position from a GNSS fix. */
+	FIX_TYPE_GNSS,
+	/* Coarse position derived from the LTE cells in range. */
+	FIX_TYPE_CELL,
+};
+
+/**@brief Compact copy of a fix, kept until it has been uploaded. */
+struct fix_record {
+	double latitude;
+	double longitude;
+	float altitude;
+	float accuracy;
+	float speed;
+	float heading;
+	struct nrf_modem_gnss_datetime datetime;
+	/* Uptime (ms) at which the fix was stored. */
+	int64_t stored_at;
+	enum fix_type type;
+};
+
+/**@brief Copy the fields of a PVT frame that are kept for upload. */
+void fix_record_from_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt,
+			 struct fix_record *record);
+
+/**@brief Store a fix in the ring buffer.
+ *
+ * When the buffer is full the oldest fix is overwritten.
+ * The buffer is only accessed from the main thread and is not locked.
+ */
+void fix_buffer_put(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
+/**@brief Store a fix that did not come from GNSS, see fix_buffer_put(). */
+void fix_buffer_put_record(const struct fix_record *record);
+
+/**@brief Number of fixes waiting to be uploaded. */
+size_t fix_buffer_count(void);
+
+/**@brief Get the fix at position @p index, counted from the oldest one.
+ *
+ * @return 0 on success, -ENOENT if there is no fix at that position.
+ */
+int fix_buffer_peek(size_t index, struct fix_record *record);
+
+/**@brief Drop the @p count oldest fixes after they have been uploaded. */
+void fix_buffer_consume(size_t count);
+
+/**@brief Check the flush policy.
+ *
+ * A flush is due when CONFIG_TRACKER_BATCH_SIZE fixes were stored since the
+ * last flush, when the buffer reached CONFIG_TRACKER_BATCH_HIGH_WATERMARK, or
+ * when the oldest fix is older than CONFIG_TRACKER_BATCH_MAX_AGE seconds.
+ */
+bool fix_buffer_flush_due(void);
+
+/**@brief Reset the "fixes since last flush" counter of the flush policy.
+ *
+ * Called after every upload attempt, successful or not, so that a failed
+ * upload is retried on the next batch instead of on every new fix.
+ */
+void fix_buffer_flush_done(void);
+
+/**@brief Time left until the oldest fix reaches the maximum age.
+ *
+ * @return K_FOREVER when the buffer is empty or the age limit is disabled.
+ */
+k_timeout_t fix_buffer_flush_timeout(void);
+
+#endif /* _FIX_BUFFER_H_ */
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "fix_interval.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+BUILD_ASSERT(CONFIG_TRACKER_FIX_INTERVAL_MIN <= CONFIG_TRACKER_FIX_INTERVAL_MAX,
+	     "Minimum fix interval must not exceed the maximum");
+
+static uint16_t interval = CLAMP(CONFIG_TRACKER_PERIODIC_INTERVAL,
+				 CONFIG_TRACKER_FIX_INTERVAL_MIN,
+				 CONFIG_TRACKER_FIX_INTERVAL_MAX);
+static float last_heading;
+static bool last_heading_valid;
+
+/* Absolute difference between two headings, in degrees (0 - 180). */
+static float heading_change(float from, float to)
+{
+	float diff = fmodf(fabsf(to - from), 360.0f);
+
+	return diff > 180.0f ? 360.0f - diff : diff;
+}
+
+uint16_t fix_interval_get(void)
+{
+	return interval;
+}
+
+uint16_t fix_interval_update(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+	bool moving = (pvt->speed * 100.0f) >= CONFIG_TRACKER_MOTION_SPEED_THRESHOLD;
+	/* A change smaller than the heading error cannot be told from noise. The
+	 * error grows as the speed drops, but a slow turn, for example at a
+	 * junction, still has a usable heading below the speed threshold.
+	 */
+	bool heading_valid = pvt->heading_accuracy < CONFIG_TRACKER_MOTION_HEADING_THRESHOLD;
+	bool turning = false;
+
+	if (heading_valid && last_heading_valid) {
+		turning = heading_change(last_heading, pvt->heading) >=
+			  CONFIG_TRACKER_MOTION_HEADING_THRESHOLD;
+	}
+
+	if (moving || turning) {
+		interval = CONFIG_TRACKER_FIX_INTERVAL_MIN;
+	} else {
+		/* Stationary, back off exponentially. */
+		interval = MIN((uint32_t)interval * 2, CONFIG_TRACKER_FIX_INTERVAL_MAX);
+	}
+
+	LOG_INF("Speed %.1f m/s, heading %.0f deg%s: fix interval %u s",
+		pvt->speed, pvt->heading, turning ? " (turning)" : "", interval);
+
+	last_heading = pvt->heading;
+	last_heading_valid = heading_valid;
+
+	return interval;
+}
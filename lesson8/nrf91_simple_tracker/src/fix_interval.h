@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _FIX_INTERVAL_H_
+#define _FIX_INTERVAL_H_
+
+#include <stdint.h>
+#include <nrf_modem_gnss.h>
+
+/**@brief Motion-adaptive GNSS fix interval.
+ *
+ * While the device is moving (speed above CONFIG_TRACKER_MOTION_SPEED_THRESHOLD)
+ * or turning (heading change above CONFIG_TRACKER_MOTION_HEADING_THRESHOLD),
+ * fixes are taken every CONFIG_TRACKER_FIX_INTERVAL_MIN seconds. Turns are
+ * detected at any speed, as long as the heading accuracy of both fixes is
+ * better than the threshold. While it is
+ * stationary the interval doubles with every fix, up to
+ * CONFIG_TRACKER_FIX_INTERVAL_MAX seconds.
+ */
+
+/**@brief Current fix interval in seconds. */
+uint16_t fix_interval_get(void);
+
+/**@brief Update the fix interval with a new fix.
+ *
+ * @return The fix interval in seconds to use from now on.
+ */
+uint16_t fix_interval_update(const struct nrf_modem_gnss_pvt_data_frame *pvt);
+
+#endif /* _FIX_INTERVAL_H_ */
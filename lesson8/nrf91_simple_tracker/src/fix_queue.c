@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "fix_queue.h"
+#include "storage.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+BUILD_ASSERT(STORAGE_ID_FIX_QUEUE_BASE + CONFIG_TRACKER_FIX_QUEUE_CAPACITY <= UINT16_MAX,
+	     "Fix queue does not fit in the NVS id space");
+
+/* Entry as stored in flash. The sequence number identifies the slot content. */
+struct fix_queue_entry {
+	uint32_t seq;
+	struct fix_record record;
+};
+
+/* Sequence number of the next fix to write. */
+static uint32_t write_seq;
+/* Sequence number of the oldest fix not yet uploaded. */
+static uint32_t read_seq;
+
+static struct {
+	uint32_t appended;
+	uint32_t dropped;
+	uint32_t drained;
+	uint32_t cursor_writes;
+	size_t bytes_appended;
+} stats;
+
+static uint16_t slot_id(uint32_t seq)
+{
+	return STORAGE_ID_FIX_QUEUE_BASE + (seq % CONFIG_TRACKER_FIX_QUEUE_CAPACITY);
+}
+
+static int read_cursor_store(void)
+{
+	ssize_t ret;
+
+	ret = nvs_write(storage_fs(), STORAGE_ID_FIX_QUEUE_READ, &read_seq, sizeof(read_seq));
+	if (ret < 0) {
+		LOG_ERR("Failed to store fix queue read cursor, error: %d", (int)ret);
+		return ret;
+	}
+
+	stats.cursor_writes++;
+
+	return 0;
+}
+
+int fix_queue_init(void)
+{
+	struct nvs_fs *fs = storage_fs();
+	struct fix_queue_entry entry;
+	bool found = false;
+	ssize_t ret;
+
+	if (fs == NULL) {
+		return -ENODEV;
+	}
+
+	ret = nvs_read(fs, STORAGE_ID_FIX_QUEUE_READ, &read_seq, sizeof(read_seq));
+	if (ret != sizeof(read_seq)) {
+		read_seq = 0;
+	}
+
+	/* The newest entry gives the write position. */
+	write_seq = read_seq;
+	for (uint32_t i = 0; i < CONFIG_TRACKER_FIX_QUEUE_CAPACITY; i++) {
+		ret = nvs_read(fs, STORAGE_ID_FIX_QUEUE_BASE + i, &entry, sizeof(entry));
+		if (ret != sizeof(entry)) {
+			continue;
+		}
+
+		if (!found || ((int32_t)(entry.seq - write_seq) >= 0)) {
+			write_seq = entry.seq + 1;
+			found = true;
+		}
+	}
+
+	if ((int32_t)(write_seq - read_seq) < 0) {
+		/* Nothing written after the cursor, the queue is empty. */
+		write_seq = read_seq;
+	} else if ((write_seq - read_seq) > CONFIG_TRACKER_FIX_QUEUE_CAPACITY) {
+		read_seq = write_seq - CONFIG_TRACKER_FIX_QUEUE_CAPACITY;
+	}
+
+	LOG_INF("Fix queue: %zu fixes pending", fix_queue_count());
+
+	return 0;
+}
+
+int fix_queue_append(const struct fix_record *record)
+{
+	struct fix_queue_entry entry = {
+		.seq = write_seq,
+		.record = *record,
+	};
+	ssize_t ret;
+
+	if (storage_fs() == NULL) {
+		return -ENODEV;
+	}
+
+	ret = nvs_write(storage_fs(), slot_id(write_seq), &entry, sizeof(entry));
+	if (ret < 0) {
+		LOG_ERR("Failed to append fix to queue, error: %d", (int)ret);
+		return ret;
+	}
+
+	write_seq++;
+	stats.appended++;
+	stats.bytes_appended += sizeof(entry);
+
+	if ((write_seq - read_seq) > CONFIG_TRACKER_FIX_QUEUE_CAPACITY) {
+		/* The slot of the oldest fix was just reused. */
+		read_seq++;
+		stats.dropped++;
+	}
+
+	return 0;
+}
+
+size_t fix_queue_count(void)
+{
+	return write_seq - read_seq;
+}
+
+int fix_queue_peek(size_t index, struct fix_record *record)
+{
+	struct fix_queue_entry entry;
+	uint32_t seq = read_seq + index;
+	ssize_t ret;
+
+	if ((index >= fix_queue_count()) || (storage_fs() == NULL)) {
+		return -ENOENT;
+	}
+
+	ret = nvs_read(storage_fs(), slot_id(seq), &entry, sizeof(entry));
+	if ((ret != sizeof(entry)) || (entry.seq != seq)) {
+		return -ENOENT;
+	}
+
+	*record = entry.record;
+
+	return 0;
+}
+
+void fix_queue_consume(size_t count)
+{
+	count = MIN(count, fix_queue_count());
+	if (count == 0) {
+		return;
+	}
+
+	read_seq += count;
+	stats.drained += count;
+
+	/* On failure the fixes are uploaded again after a reboot. */
+	(void)read_cursor_store();
+}
+
+void fix_queue_stats_log(void)
+{
+	LOG_INF("Fix queue: %u appended (%zu bytes), %u drained, %u dropped, "
+		"%u cursor writes, %zu pending",
+		stats.appended, stats.bytes_appended, stats.drained, stats.dropped,
+		stats.cursor_writes, fix_queue_count());
+}
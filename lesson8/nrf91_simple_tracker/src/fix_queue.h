@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _FIX_QUEUE_H_
+#define _FIX_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fix_buffer.h"
+
+/**@brief Persistent store-and-forward queue of fixes.
+ *
+ * Fixes that could not be uploaded are appended to an append-only queue in
+ * NVS and drained in batches on the next successful connection. The write
+ * position is recovered from the stored entries at boot, so an append costs
+ * a single flash write. The read cursor is persisted once per drained batch.
+ */
+
+/**@brief Recover the queue from flash. Requires storage_init(). */
+int fix_queue_init(void);
+
+/**@brief Append a fix. When the queue is full the oldest fix is dropped. */
+int fix_queue_append(const struct fix_record *record);
+
+/**@brief Number of fixes waiting in the queue. */
+size_t fix_queue_count(void);
+
+/**@brief Get the fix at position @p index, counted from the read cursor.
+ *
+ * @return 0 on success, -ENOENT if the fix is missing or unreadable.
+ */
+int fix_queue_peek(size_t index, struct fix_record *record);
+
+/**@brief Advance and persist the read cursor past @p count fixes. */
+void fix_queue_consume(size_t count);
+
+/**@brief Log append and drain statistics. */
+void fix_queue_stats_log(void);
+
+#endif /* _FIX_QUEUE_H_ */
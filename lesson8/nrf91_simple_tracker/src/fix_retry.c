@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "fix_retry.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+/* Broadcast ephemerides are valid for about four hours. */
+#define HOT_START_MAX_AGE_MS (4LL * 60 * 60 * MSEC_PER_SEC)
+/* Past this the almanac is too old to help much. */
+#define WARM_START_MAX_AGE_MS (7LL * 24 * 60 * 60 * MSEC_PER_SEC)
+/* Use the static timeout until this many fixes of a start type were seen. */
+#define MIN_SAMPLES 4
+/* While giving up early, every this many searches use the full timeout. */
+#define PROBE_INTERVAL 4
+/* Search time recorded for a search that timed out. */
+#define SEARCH_FAILED UINT32_MAX
+
+BUILD_ASSERT(CONFIG_TRACKER_FIX_RETRY_HISTORY >= MIN_SAMPLES,
+	     "The TTFF history must hold at least MIN_SAMPLES searches");
+
+enum start_type {
+	START_HOT,
+	START_WARM,
+	START_COLD,
+	START_TYPE_COUNT
+};
+
+static const char *const start_type_names[] = { "hot", "warm", "cold" };
+
+struct ttff_history {
+	uint32_t search_ms[CONFIG_TRACKER_FIX_RETRY_HISTORY];
+	size_t next;
+	size_t count;
+	/* Totals since boot, for the statistics. */
+	uint32_t fixes;
+	uint32_t timeouts;
+};
+
+static struct ttff_history history[START_TYPE_COUNT];
+/* Uptime of the last fix, -1 before the first one. */
+static int64_t last_fix_ms = -1;
+/* The next search gives up early. */
+static bool giving_up;
+static uint32_t give_up_count;
+static uint32_t early_timeouts;
+
+static enum start_type start_type_get(int64_t start_ms)
+{
+	int64_t age = start_ms - last_fix_ms;
+
+	if (last_fix_ms < 0) {
+		return START_COLD;
+	} else if (age < HOT_START_MAX_AGE_MS) {
+		return START_HOT;
+	} else if (age < WARM_START_MAX_AGE_MS) {
+		return START_WARM;
+	}
+
+	return START_COLD;
+}
+
+void fix_retry_record(uint32_t search_ms, bool fixed)
+{
+	int64_t now = k_uptime_get();
+	struct ttff_history *h = &history[start_type_get(now - search_ms)];
+
+	if (fixed) {
+		last_fix_ms = now;
+		h->fixes++;
+	} else if (giving_up) {
+		/* A short search says nothing about the TTFF, keep it out of the history. */
+		early_timeouts++;
+		return;
+	} else {
+		h->timeouts++;
+	}
+
+	h->search_ms[h->next] = fixed ? search_ms : SEARCH_FAILED;
+	h->next = (h->next + 1) % ARRAY_SIZE(h->search_ms);
+	h->count = MIN(h->count + 1, ARRAY_SIZE(h->search_ms));
+}
+
+/* Percentile of the search times, 0 if there are too few of them.
+ * Failed searches sort last, as if they never finished, so the result is
+ * SEARCH_FAILED when the percentile falls on one of them.
+ */
+static uint32_t ttff_percentile(const struct ttff_history *h)
+{
+	uint32_t sorted[CONFIG_TRACKER_FIX_RETRY_HISTORY];
+	size_t n = h->count;
+
+	if (n < MIN_SAMPLES) {
+		return 0;
+	}
+
+	/* Insertion sort, the history is small. */
+	for (size_t i = 0; i < n; i++) {
+		uint32_t value = h->search_ms[i];
+		size_t j;
+
+		for (j = i; (j > 0) && (sorted[j - 1] > value); j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = value;
+	}
+
+	return sorted[DIV_ROUND_UP(n * CONFIG_TRACKER_FIX_RETRY_PERCENTILE, 100) - 1];
+}
+
+uint16_t fix_retry_get(uint16_t interval)
+{
+	enum start_type type = start_type_get(k_uptime_get() + interval * MSEC_PER_SEC);
+	const struct ttff_history *h = &history[type];
+	size_t failed = 0;
+	uint32_t ttff_ms;
+	uint32_t timeout;
+
+	if (CONFIG_TRACKER_PERIODIC_TIMEOUT == 0) {
+		/* Searches never time out, there is nothing to learn. */
+		return 0;
+	}
+
+	for (size_t i = 0; i < h->count; i++) {
+		failed += (h->search_ms[i] == SEARCH_FAILED) ? 1 : 0;
+	}
+
+	giving_up = (h->count >= MIN_SAMPLES) &&
+		    ((failed * 100) >= (h->count * CONFIG_TRACKER_FIX_RETRY_GIVE_UP_RATE));
+	if (giving_up) {
+		if ((++give_up_count % PROBE_INTERVAL) != 0) {
+			LOG_INF("%zu of the last %zu %s start searches failed, giving up after %u s",
+				failed, h->count, start_type_names[type],
+				CONFIG_TRACKER_FIX_RETRY_MIN);
+			return CONFIG_TRACKER_FIX_RETRY_MIN;
+		}
+		/* Probe with the full timeout, in case fixes work again. */
+		giving_up = false;
+		return CONFIG_TRACKER_PERIODIC_TIMEOUT;
+	}
+
+	ttff_ms = ttff_percentile(h);
+	if ((ttff_ms == 0) || (ttff_ms == SEARCH_FAILED)) {
+		return CONFIG_TRACKER_PERIODIC_TIMEOUT;
+	}
+
+	timeout = DIV_ROUND_UP((uint64_t)ttff_ms * (100 + CONFIG_TRACKER_FIX_RETRY_MARGIN),
+			       100 * MSEC_PER_SEC);
+	timeout = MAX(timeout, CONFIG_TRACKER_FIX_RETRY_MIN);
+
+	return MIN(timeout, CONFIG_TRACKER_PERIODIC_TIMEOUT);
+}
+
+void fix_retry_stats_log(void)
+{
+	for (size_t i = 0; i < START_TYPE_COUNT; i++) {
+		uint32_t ttff_ms = ttff_percentile(&history[i]);
+
+		if (ttff_ms == SEARCH_FAILED) {
+			LOG_INF("%s starts: %u fixes, %u timeouts, p%u TTFF not reached",
+				start_type_names[i], history[i].fixes, history[i].timeouts,
+				CONFIG_TRACKER_FIX_RETRY_PERCENTILE);
+			continue;
+		}
+		LOG_INF("%s starts: %u fixes, %u timeouts, p%u TTFF %u ms",
+			start_type_names[i], history[i].fixes, history[i].timeouts,
+			CONFIG_TRACKER_FIX_RETRY_PERCENTILE, ttff_ms);
+	}
+	LOG_INF("Searches given up early: %u", early_timeouts);
+}
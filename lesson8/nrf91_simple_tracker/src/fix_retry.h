@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _FIX_RETRY_H_
+#define _FIX_RETRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**@brief GNSS fix retry timeout learned from the time to first fix (TTFF).
+ *
+ * Every search is classified as a hot, warm or cold start by the time since
+ * the last fix, and its search time is kept in a rolling history per start
+ * type. The retry timeout of the next search is the
+ * CONFIG_TRACKER_FIX_RETRY_PERCENTILE percentile of the TTFF of that start
+ * type, plus CONFIG_TRACKER_FIX_RETRY_MARGIN percent. Searches that timed out
+ * count as never finishing, so when the percentile falls on one of them the
+ * full CONFIG_TRACKER_PERIODIC_TIMEOUT is used.
+ *
+ * When at least CONFIG_TRACKER_FIX_RETRY_GIVE_UP_RATE percent of the
+ * searches failed, the search gives up after CONFIG_TRACKER_FIX_RETRY_MIN
+ * seconds. Every few searches still use the full timeout, so the history
+ * recovers when the device moves to a better place.
+ *
+ * A CONFIG_TRACKER_PERIODIC_TIMEOUT of 0 keeps searching indefinitely.
+ */
+
+/**@brief Record the outcome of a GNSS search.
+ *
+ * @param search_ms Time the search took, in milliseconds.
+ * @param fixed true if the search ended with a fix, false on timeout.
+ */
+void fix_retry_record(uint32_t search_ms, bool fixed);
+
+/**@brief Retry timeout for the next search.
+ *
+ * @param interval Fix interval in seconds, the next search starts after it.
+ *
+ * @return Retry timeout in seconds, 0 to search until a fix is found.
+ */
+uint16_t fix_retry_get(uint16_t interval);
+
+/**@brief Log the TTFF statistics of every start type. */
+void fix_retry_stats_log(void);
+
+#endif /* _FIX_RETRY_H_ */
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "coap_exchange.h"
+#include "lte_session.h"
+#include "rat_policy.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+enum session_mode {
+	MODE_DEACTIVATE,
+	MODE_PSM_RESIDENT,
+	MODE_COUNT
+};
+
+static const char *const mode_names[] = { "deactivate", "PSM-resident" };
+
+struct mode_stats {
+	uint32_t cycles;
+	/* Cycles that had to attach to the network. */
+	uint32_t attaches;
+	uint32_t failures;
+	int64_t register_ms;
+	int64_t session_ms;
+};
+
+static K_SEM_DEFINE(registered_sem, 0, 1);
+static atomic_t registered;
+static atomic_t psm_resident = ATOMIC_INIT(IS_ENABLED(CONFIG_TRACKER_PSM_RESIDENT));
+/* Granted by the network, -1 while PSM is not granted. */
+static atomic_t psm_tau = ATOMIC_INIT(-1);
+static atomic_t psm_active_time = ATOMIC_INIT(-1);
+/* Last value passed to lte_lc_psm_req(), -1 before the first call. */
+static int psm_requested = -1;
+
+/* Mode and start of the current session. */
+static enum session_mode session_mode;
+static int64_t session_start;
+static uint32_t session_register_ms;
+static int64_t session_rrc_start_ms;
+static uint32_t session_bytes_start;
+
+/* RAT in use, as reported by the modem. */
+static atomic_t lte_mode;
+/* RRC connected time, updated from the LTE handler. */
+static struct k_spinlock rrc_lock;
+static int64_t rrc_connected_since;
+static int64_t rrc_connected_ms;
+static uint32_t rrc_connections;
+static uint32_t rrc_last_ms;
+/* Uptime (ms) of the end of the last upload while still RRC connected, 0 if none.
+ * The time from there to the RRC release is the tail.
+ */
+static int64_t rrc_tail_start;
+static uint32_t rrc_tails;
+static int64_t rrc_tail_ms;
+static uint32_t rrc_last_tail_ms;
+
+static struct mode_stats stats[MODE_COUNT];
+static int64_t psm_sleep_start;
+static int64_t psm_sleep_ms;
+
+void lte_session_evt_handler(const struct lte_lc_evt *const evt)
+{
+	switch (evt->type) {
+	case LTE_LC_EVT_NW_REG_STATUS:
+		if ((evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME) ||
+		    (evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_ROAMING)) {
+			atomic_set(&registered, 1);
+			k_sem_give(&registered_sem);
+		} else {
+			atomic_set(&registered, 0);
+		}
+		break;
+	case LTE_LC_EVT_PSM_UPDATE:
+		atomic_set(&psm_tau, evt->psm_cfg.tau);
+		atomic_set(&psm_active_time, evt->psm_cfg.active_time);
+		break;
+	case LTE_LC_EVT_LTE_MODE_UPDATE:
+		atomic_set(&lte_mode, evt->lte_mode);
+		break;
+	case LTE_LC_EVT_RRC_UPDATE: {
+		k_spinlock_key_t key = k_spin_lock(&rrc_lock);
+
+		int64_t now = k_uptime_get();
+
+		if (evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED) {
+			rrc_connected_since = now;
+			rrc_connections++;
+		} else if (rrc_connected_since != 0) {
+			rrc_last_ms = now - rrc_connected_since;
+			rrc_connected_ms += rrc_last_ms;
+			rrc_connected_since = 0;
+
+			if (rrc_tail_start != 0) {
+				rrc_last_tail_ms = now - rrc_tail_start;
+				rrc_tail_ms += rrc_last_tail_ms;
+				rrc_tails++;
+				rrc_tail_start = 0;
+			}
+		}
+		k_spin_unlock(&rrc_lock, key);
+		break;
+	}
+	case LTE_LC_EVT_MODEM_SLEEP_ENTER:
+		if (evt->modem_sleep.type == LTE_LC_MODEM_SLEEP_PSM) {
+			psm_sleep_start = k_uptime_get();
+		}
+		break;
+	case LTE_LC_EVT_MODEM_SLEEP_EXIT:
+		if ((evt->modem_sleep.type == LTE_LC_MODEM_SLEEP_PSM) && (psm_sleep_start != 0)) {
+			psm_sleep_ms += k_uptime_get() - psm_sleep_start;
+			psm_sleep_start = 0;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* Total RRC connected time so far, including the ongoing connection. */
+static int64_t rrc_connected_total(void)
+{
+	int64_t total;
+	k_spinlock_key_t key = k_spin_lock(&rrc_lock);
+
+	total = rrc_connected_ms;
+	if (rrc_connected_since != 0) {
+		total += k_uptime_get() - rrc_connected_since;
+	}
+	k_spin_unlock(&rrc_lock, key);
+
+	return total;
+}
+
+static bool psm_granted(void)
+{
+	return (atomic_get(&psm_tau) > 0) && (atomic_get(&psm_active_time) >= 0);
+}
+
+int lte_session_open(void)
+{
+	int err;
+	int64_t registered_at;
+	bool resident = atomic_get(&psm_resident);
+
+	session_mode = resident ? MODE_PSM_RESIDENT : MODE_DEACTIVATE;
+	session_start = k_uptime_get();
+	session_register_ms = 0;
+	session_rrc_start_ms = rrc_connected_total();
+	session_bytes_start = coap_exchange_bytes();
+	stats[session_mode].cycles++;
+
+	if (resident != psm_requested) {
+		err = lte_lc_psm_req(resident);
+		if (err) {
+			LOG_ERR("Failed to %s PSM: %d", resident ? "request" : "disable", err);
+		} else {
+			psm_requested = resident;
+		}
+	}
+
+	/* Sending wakes the modem from PSM, no need to attach again. */
+	if (resident && atomic_get(&registered)) {
+		LOG_INF("Still registered, resuming from PSM");
+		return 0;
+	}
+
+	stats[session_mode].attaches++;
+	k_sem_reset(&registered_sem);
+
+#if defined(CONFIG_TRACKER_RAT_POLICY)
+	rat_policy_apply();
+#endif
+
+	err = lte_lc_func_mode_set(LTE_LC_FUNC_MODE_NORMAL);
+	if (err) {
+		LOG_ERR("Failed to activate LTE");
+		return err;
+	}
+
+	if (k_sem_take(&registered_sem, K_SECONDS(CONFIG_TRACKER_LTE_CONNECT_TIMEOUT)) != 0) {
+		LOG_ERR("Timed out waiting for LTE connection");
+#if defined(CONFIG_TRACKER_RAT_POLICY)
+		rat_policy_failure();
+#endif
+		return -ETIMEDOUT;
+	}
+
+	registered_at = k_uptime_get();
+	session_register_ms = registered_at - session_start;
+	stats[session_mode].register_ms += session_register_ms;
+	LOG_INF("Registered to the network in %lld ms", registered_at - session_start);
+
+	return 0;
+}
+
+/* Start measuring the RRC tail of the upload that just ended. */
+static void rrc_tail_begin(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&rrc_lock);
+
+	if (rrc_connected_since != 0) {
+		rrc_tail_start = k_uptime_get();
+	} else {
+		/* Already released, for example after a Release Assistance Indication. */
+		rrc_last_tail_ms = 0;
+		rrc_tails++;
+	}
+	k_spin_unlock(&rrc_lock, key);
+}
+
+int lte_session_close(bool ok)
+{
+	int err = 0;
+	struct mode_stats *s = &stats[session_mode];
+
+	if (ok) {
+		rrc_tail_begin();
+	}
+
+	s->session_ms += k_uptime_get() - session_start;
+	if (!ok) {
+		s->failures++;
+	}
+
+#if defined(CONFIG_TRACKER_RAT_POLICY)
+	if (ok) {
+		/* The RRC tail after the close is not counted in PSM-resident mode. */
+		rat_policy_record(atomic_get(&lte_mode), session_register_ms,
+				  rrc_connected_total() - session_rrc_start_ms,
+				  coap_exchange_bytes() - session_bytes_start);
+	}
+#endif
+
+	if (!ok || (session_mode == MODE_DEACTIVATE) || !psm_granted()) {
+		if ((session_mode == MODE_PSM_RESIDENT) && ok) {
+			LOG_WRN("PSM not granted by the network, deactivating LTE");
+		}
+
+		atomic_set(&registered, 0);
+		err = lte_lc_func_mode_set(LTE_LC_FUNC_MODE_DEACTIVATE_LTE);
+		if (err) {
+			LOG_ERR("Failed to deactivate LTE and enable GNSS functional mode");
+		}
+	}
+
+	lte_session_stats_log();
+#if defined(CONFIG_TRACKER_RAT_POLICY)
+	rat_policy_stats_log();
+#endif
+
+	return err;
+}
+
+void lte_session_psm_resident_set(bool enable)
+{
+	atomic_set(&psm_resident, enable);
+	LOG_INF("Upload mode: %s", mode_names[enable ? MODE_PSM_RESIDENT : MODE_DEACTIVATE]);
+}
+
+bool lte_session_psm_resident(void)
+{
+	return atomic_get(&psm_resident);
+}
+
+void lte_session_stats_log(void)
+{
+	for (size_t i = 0; i < MODE_COUNT; i++) {
+		const struct mode_stats *s = &stats[i];
+
+		if (s->cycles == 0) {
+			continue;
+		}
+
+		LOG_INF("%s: %u cycles, %u attaches (avg %lld ms), %u failed, avg session %lld ms",
+			mode_names[i], s->cycles, s->attaches,
+			s->attaches ? s->register_ms / s->attaches : 0,
+			s->failures, s->session_ms / s->cycles);
+	}
+
+	if (rrc_connections > 0) {
+		LOG_INF("RRC: %u connections, last %u ms, avg %lld ms connected",
+			rrc_connections, rrc_last_ms, rrc_connected_total() / rrc_connections);
+	}
+
+	if (rrc_tails > 0) {
+		LOG_INF("RRC tail after the upload: last %u ms, avg %lld ms",
+			rrc_last_tail_ms, rrc_tail_ms / rrc_tails);
+	}
+
+	if (psm_granted()) {
+		LOG_INF("PSM granted: TAU %ld s, active time %ld s, %lld s in PSM sleep",
+			atomic_get(&psm_tau), atomic_get(&psm_active_time),
+			psm_sleep_ms / MSEC_PER_SEC);
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _LTE_SESSION_H_
+#define _LTE_SESSION_H_
+
+#include <stdbool.h>
+#include <modem/lte_lc.h>
+
+/**@brief LTE connection handling around uploads.
+ *
+ * In the default mode LTE is deactivated after every upload and the modem
+ * attaches to the network again for the next one. In PSM-resident mode
+ * the modem stays registered and sleeps in PSM between uploads, and GNSS
+ * runs while it sleeps. An upload then only wakes the modem, without a new
+ * attach. When the network does not grant PSM, LTE is deactivated after
+ * the upload like in the default mode.
+ */
+
+/**@brief Pass LTE link controller events to the session handling.
+ *
+ * Called from the LTE event handler.
+ */
+void lte_session_evt_handler(const struct lte_lc_evt *const evt);
+
+/**@brief Get LTE ready for an upload.
+ *
+ * Activates LTE unless the modem is still registered in PSM-resident mode,
+ * and waits up to CONFIG_TRACKER_LTE_CONNECT_TIMEOUT seconds for the
+ * network registration.
+ *
+ * @return 0 when registered, -ETIMEDOUT if the network was not found in
+ *	   time, or a negative error code from lte_lc.
+ */
+int lte_session_open(void);
+
+/**@brief End the upload started with lte_session_open().
+ *
+ * @param ok false if the upload failed, LTE is then always deactivated.
+ *
+ * @return 0 on success, or a negative error code from lte_lc.
+ */
+int lte_session_close(bool ok);
+
+/**@brief Select PSM-resident mode, from the next upload on. */
+void lte_session_psm_resident_set(bool enable);
+
+/**@brief Check whether PSM-resident mode is selected. */
+bool lte_session_psm_resident(void);
+
+/**@brief Log the per-mode timing counters. */
+void lte_session_stats_log(void);
+
+#endif /* _LTE_SESSION_H_ */
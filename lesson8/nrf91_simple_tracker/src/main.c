@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <zephyr/kernel.h>
 #include <zephyr/net/coap.h>
@@ -17,24 +18,87 @@
 #include <modem/modem_key_mgmt.h>
 #include <dk_buttons_and_leds.h>
 #include <nrf_modem_gnss.h>
+#include <zephyr/sys/atomic.h>
+
+#include "cell_location.h"
+#include "coap_exchange.h"
+#include "deadband.h"
+#include "dns_cache.h"
+#include "energy.h"
+#include "fix_buffer.h"
+#include "fix_interval.h"
+#include "fix_queue.h"
+#include "fix_retry.h"
+#include "lte_session.h"
+#include "pvt_ring.h"
+#include "rat_policy.h"
+#include "simplify.h"
+#include "storage.h"
+#include "tau_sched.h"
+#include "track_codec.h"
+#include "track_db.h"
 
 #define SEC_TAG 12
 #define APP_COAP_SEND_INTERVAL_MS 60000
 #define APP_COAP_MAX_MSG_LEN 1280
 #define APP_COAP_VERSION 1
+#define APP_CELL_MEAS_TIMEOUT_S 10
 static int sock;
 static struct sockaddr_storage server;
 static uint16_t next_token;
-K_SEM_DEFINE(lte_connected, 0, 1);
 K_SEM_DEFINE(gnss_fix_sem, 0, 1);
 LOG_MODULE_REGISTER(Cellfund_Project, LOG_LEVEL_INF);
 static uint8_t coap_buf[APP_COAP_MAX_MSG_LEN];
+static uint8_t coap_rx_buf[APP_COAP_MAX_MSG_LEN];
+static struct coap_exchange exchange;
+static enum coap_exchange_result exchange_result;
+#if defined(CONFIG_TRACKER_TRACK_DB)
+/* Block size of the fix history, SZX 5 is 512 bytes. */
+#define APP_TRACK_DB_SZX 5
+/* Experimental option (RFC 7252, section 12.2) in the response to an upload:
+ * time (ms) the server wants the device to wait for history queries.
+ */
+#define APP_COAP_OPTION_TRACK_DB_LISTEN 65000
+static int track_db_listen_ms;
+static uint8_t coap_response_buf[APP_COAP_MAX_MSG_LEN];
+static uint8_t track_db_buf[1 << (APP_TRACK_DB_SZX + 4)];
+#endif
+#if defined(CONFIG_TRACKER_BINARY_PAYLOAD)
+static uint8_t track_buf[APP_COAP_MAX_MSG_LEN];
+#else
 static uint8_t coap_sendbug[64];
-static struct nrf_modem_gnss_pvt_data_frame current_pvt;
-static struct nrf_modem_gnss_pvt_data_frame last_pvt;
+#endif
 static enum tracker_status {status_nolte = DK_LED1, status_searching = DK_LED2, status_fixed = DK_LED3} device_status;
 static int resolve_address_lock = 0;
-static void print_fix_data(struct nrf_modem_gnss_pvt_data_frame *pvt_data)
+/* GNSS fix interval currently in use, in seconds. */
+static uint16_t gnss_interval = CONFIG_TRACKER_PERIODIC_INTERVAL;
+/* GNSS fix retry timeout currently in use, in seconds. */
+static uint16_t gnss_retry = CONFIG_TRACKER_PERIODIC_TIMEOUT;
+/* Uptime (ms, 32 bits) at which the current GNSS search started. */
+static atomic_t gnss_search_start;
+/* Duration (ms) of the last finished GNSS search, -1 once it was handled. */
+static atomic_t gnss_search_time = ATOMIC_INIT(-1);
+/* Set once the modem holds a DTLS session that the next connect() can resume. */
+static bool dtls_session_cached;
+/* DTLS handshake counters, to measure the savings of session resumption. */
+static struct {
+	uint32_t full;
+	uint32_t resumed;
+	uint32_t resume_failed;
+	/* Handshakes with a cached session where the modem did not report the outcome. */
+	uint32_t unknown;
+	int64_t full_time_ms;
+	int64_t resumed_time_ms;
+	int64_t unknown_time_ms;
+} dtls_stats;
+/* Set by the GNSS handler when a search timed out. */
+static atomic_t gnss_timed_out;
+/* A coarse position is to be taken from the LTE cells on the next connection. */
+static bool cell_fallback_pending;
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+static struct simplify track;
+#endif
+static void print_fix_data(const struct nrf_modem_gnss_pvt_data_frame *pvt_data)
 {
 	printk("Latitude:       %.06f\n", pvt_data->latitude);
 	printk("Longitude:      %.06f\n", pvt_data->longitude);
@@ -49,6 +113,7 @@ static void print_fix_data(struct nrf_modem_gnss_pvt_data_frame *pvt_data)
 static void gnss_event_handler(int event)
 {
 	int retval;
+	struct nrf_modem_gnss_pvt_data_frame *pvt;
 	switch (event) {
 	case NRF_MODEM_GNSS_EVT_PVT:
 		LOG_INF("Searching for GNSS Satellites....\n\r");
@@ -59,6 +124,10 @@ static void gnss_event_handler(int event)
 		break;
 	case NRF_MODEM_GNSS_EVT_PERIODIC_WAKEUP:
 		LOG_INF("GNSS woke up in periodic mode\n\r");
+		atomic_set(&gnss_search_start, k_uptime_get_32());
+#if defined(CONFIG_TRACKER_ENERGY)
+		energy_gnss_state_set(ENERGY_GNSS_SEARCH);
+#endif
 		break;
 	case NRF_MODEM_GNSS_EVT_BLOCKED:
 		LOG_INF("GNSS is blocked by LTE event\n\r");
@@ -66,15 +135,29 @@ static void gnss_event_handler(int event)
 	case NRF_MODEM_GNSS_EVT_SLEEP_AFTER_FIX:
 		LOG_INF("GNSS enters sleep because fix was achieved in periodic mode\n\r");
 		device_status = status_fixed;
-		retval = nrf_modem_gnss_read(&last_pvt, sizeof(last_pvt), NRF_MODEM_GNSS_DATA_PVT);
+		atomic_set(&gnss_search_time, k_uptime_get_32() - atomic_get(&gnss_search_start));
+#if defined(CONFIG_TRACKER_ENERGY)
+		energy_gnss_state_set(ENERGY_GNSS_SLEEP);
+#endif
+		/* Only hand the frame over here, it is processed by the main thread. */
+		pvt = pvt_ring_claim();
+		if (pvt == NULL) {
+			break;
+		}
+		retval = nrf_modem_gnss_read(pvt, sizeof(*pvt), NRF_MODEM_GNSS_DATA_PVT);
 		if (retval == 0){
-			current_pvt = last_pvt;
-			print_fix_data(&current_pvt);
+			pvt_ring_publish();
 			k_sem_give(&gnss_fix_sem);
 		}
 		break;
 	case NRF_MODEM_GNSS_EVT_SLEEP_AFTER_TIMEOUT:
 		LOG_INF("GNSS enters sleep because fix retry timeout was reached\n\r");
+		atomic_set(&gnss_search_time, k_uptime_get_32() - atomic_get(&gnss_search_start));
+		atomic_set(&gnss_timed_out, 1);
+#if defined(CONFIG_TRACKER_ENERGY)
+		energy_gnss_state_set(ENERGY_GNSS_SLEEP);
+#endif
+		k_sem_give(&gnss_fix_sem);
 		break;
 
 	default:
@@ -105,12 +188,15 @@ static int gnss_init_and_start(void)
 		return -1;
 	}
 
-	if (nrf_modem_gnss_fix_interval_set(CONFIG_TRACKER_PERIODIC_INTERVAL) != 0) {
+#if defined(CONFIG_TRACKER_ADAPTIVE_INTERVAL)
+	gnss_interval = fix_interval_get();
+#endif
+	if (nrf_modem_gnss_fix_interval_set(gnss_interval) != 0) {
 		LOG_ERR("Failed to set GNSS fix interval");
 		return -1;
 	}
 
-	if (nrf_modem_gnss_fix_retry_set(CONFIG_TRACKER_PERIODIC_TIMEOUT) != 0) {
+	if (nrf_modem_gnss_fix_retry_set(gnss_retry) != 0) {
 		LOG_ERR("Failed to set GNSS fix retry");
 		return -1;
 	}
@@ -119,6 +205,10 @@ static int gnss_init_and_start(void)
 		LOG_ERR("Failed to start GNSS");
 		return -1;
 	}
+	atomic_set(&gnss_search_start, k_uptime_get_32());
+#if defined(CONFIG_TRACKER_ENERGY)
+	energy_gnss_state_set(ENERGY_GNSS_SEARCH);
+#endif
 	if (nrf_modem_gnss_prio_mode_enable() != 0){
 		LOG_ERR("Error setting GNSS priority mode");
 		return -1;
@@ -126,9 +216,76 @@ static int gnss_init_and_start(void)
 	return 0;
 }
 
+#if defined(CONFIG_TRACKER_ADAPTIVE_INTERVAL) || defined(CONFIG_TRACKER_FIX_RETRY_LEARNED)
+static void gnss_start_work_fn(struct k_work *work)
+{
+	if (nrf_modem_gnss_start() != 0) {
+		LOG_ERR("Failed to start GNSS");
+		return;
+	}
+	atomic_set(&gnss_search_start, k_uptime_get_32());
+#if defined(CONFIG_TRACKER_ENERGY)
+	energy_gnss_state_set(ENERGY_GNSS_SEARCH);
+#endif
+}
+
+static K_WORK_DELAYABLE_DEFINE(gnss_start_work, gnss_start_work_fn);
+
+/**@brief Change the GNSS fix interval and fix retry timeout.
+ * They can only be changed while GNSS is stopped. Starting GNSS triggers a
+ * search right away, so the restart is delayed by the new interval.
+ */
+static int gnss_periodic_change(uint16_t interval, uint16_t retry)
+{
+	if ((interval == gnss_interval) && (retry == gnss_retry)) {
+		return 0;
+	}
+
+	/* GNSS is already stopped while a restart is pending. */
+	if (!k_work_delayable_is_pending(&gnss_start_work) && (nrf_modem_gnss_stop() != 0)) {
+		LOG_ERR("Failed to stop GNSS");
+		return -1;
+	}
+#if defined(CONFIG_TRACKER_ENERGY)
+	energy_gnss_state_set(ENERGY_GNSS_OFF);
+#endif
+
+	if (nrf_modem_gnss_fix_interval_set(interval) != 0) {
+		LOG_ERR("Failed to set GNSS fix interval");
+		return -1;
+	}
+
+	if (nrf_modem_gnss_fix_retry_set(retry) != 0) {
+		LOG_ERR("Failed to set GNSS fix retry");
+		return -1;
+	}
+
+	if (retry != gnss_retry) {
+		LOG_INF("GNSS fix retry timeout %u s", retry);
+	}
+
+	gnss_interval = interval;
+	gnss_retry = retry;
+	k_work_reschedule(&gnss_start_work, K_SECONDS(interval));
+
+	return 0;
+}
+#endif
+
 /**@brief Resolves the configured hostname. */
 static int server_resolve(void)
 {
+#if defined(CONFIG_TRACKER_DNS_CACHE)
+	struct sockaddr_in *server4 = ((struct sockaddr_in *)&server);
+
+	if (dns_cache_get(&server4->sin_addr) != 0) {
+		return -EIO;
+	}
+	server4->sin_family = AF_INET;
+	server4->sin_port = htons(CONFIG_COAP_SERVER_PORT);
+
+	return 0;
+#else
 	int err;
 	struct addrinfo *result;
 	struct addrinfo hints = {
@@ -164,10 +321,11 @@ static int server_resolve(void)
 	freeaddrinfo(result);
 
 	return 0;
+#endif
 }
 
-/**@brief Initialize the CoAP client */
-static int server_connect(void)
+/**@brief Create the DTLS socket and set up its security options. */
+static int server_socket_open(void)
 {
 	int err;
 
@@ -209,13 +367,117 @@ static int server_connect(void)
 		return -errno;
 	}
 
+#if defined(CONFIG_TRACKER_DTLS_SESSION_CACHE)
+	/* Let the modem keep the session after the socket is closed, so the
+	 * next connect() can resume it instead of doing a full handshake.
+	 */
+	int session_cache = TLS_SESSION_CACHE_ENABLED;
+
+	err = setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE, &session_cache,
+			 sizeof(session_cache));
+	if (err) {
+		LOG_ERR("Failed to enable DTLS session cache, errno %d\n", errno);
+		return -errno;
+	}
+#endif
+
+	return 0;
+}
+
+/**@brief Check whether the last handshake on the socket resumed a cached session.
+ *
+ * @return 1 if the session was resumed, 0 for a full handshake, or -1 if a
+ *         cached session was offered but the modem does not report the outcome.
+ */
+static int server_session_resumed(void)
+{
+#if defined(TLS_DTLS_HANDSHAKE_STATUS)
+	int status;
+	socklen_t len = sizeof(status);
+
+	if (getsockopt(sock, SOL_TLS, TLS_DTLS_HANDSHAKE_STATUS, &status, &len) == 0) {
+		return status == TLS_DTLS_HANDSHAKE_STATUS_CACHED;
+	}
+#endif
+	/* Without a cached session the handshake can only have been a full one. */
+	return dtls_session_cached ? -1 : 0;
+}
+
+static void dtls_stats_log(void)
+{
+	LOG_INF("DTLS handshakes: %u full (%lld ms), %u resumed (%lld ms), %u unknown (%lld ms), "
+		"%u failed resumptions",
+		dtls_stats.full, dtls_stats.full_time_ms,
+		dtls_stats.resumed, dtls_stats.resumed_time_ms,
+		dtls_stats.unknown, dtls_stats.unknown_time_ms,
+		dtls_stats.resume_failed);
+}
+
+/**@brief Initialize the CoAP client */
+static int server_connect(void)
+{
+	int err;
+	int64_t start;
+
+	err = server_socket_open();
+	if (err) {
+		if (sock >= 0) {
+			(void)close(sock);
+		}
+		return err;
+	}
+
+	start = k_uptime_get();
 	err = connect(sock, (struct sockaddr *)&server,
 		      sizeof(struct sockaddr_in));
+	if ((err < 0) && dtls_session_cached) {
+		/* The server may have dropped the session, purge it and retry
+		 * once with a full handshake.
+		 */
+		LOG_WRN("DTLS session resumption failed: %d, retrying with a full handshake\n",
+			errno);
+		dtls_stats.resume_failed++;
+		dtls_session_cached = false;
+		(void)setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE_PURGE, &(int){ 0 }, sizeof(int));
+		(void)close(sock);
+
+		err = server_socket_open();
+		if (err) {
+			if (sock >= 0) {
+				(void)close(sock);
+			}
+			return err;
+		}
+
+		start = k_uptime_get();
+		err = connect(sock, (struct sockaddr *)&server,
+			      sizeof(struct sockaddr_in));
+	}
 	if (err < 0) {
 		LOG_ERR("Connect failed : %d\n", errno);
-		return -errno;
+		err = -errno;
+		(void)close(sock);
+		return err;
 	}
 
+	switch (server_session_resumed()) {
+	case 1:
+		dtls_stats.resumed++;
+		dtls_stats.resumed_time_ms += k_uptime_get() - start;
+		break;
+	case 0:
+		dtls_stats.full++;
+		dtls_stats.full_time_ms += k_uptime_get() - start;
+		break;
+	default:
+		/* Compare the time against the full handshakes to tell. */
+		dtls_stats.unknown++;
+		dtls_stats.unknown_time_ms += k_uptime_get() - start;
+		break;
+	}
+	dtls_session_cached = IS_ENABLED(CONFIG_TRACKER_DTLS_SESSION_CACHE);
+	dtls_stats_log();
+
 	/* Randomize token. */
 	next_token = sys_rand32_get();
 
@@ -223,31 +485,15 @@ static int server_connect(void)
 }
 
 /**@brief Handles responses from the remote CoAP server. */
-static int client_handle_get_response(uint8_t *buf, int received)
+static void client_handle_response(const struct coap_packet *reply)
 {
-	int err;
-	struct coap_packet reply;
 	const uint8_t *payload;
 	uint16_t payload_len;
 	uint8_t token[8];
-	uint16_t token_len;
 	static uint8_t temp_buf[128];
 
-	err = coap_packet_parse(&reply, buf, received, NULL, 0);
-	if (err < 0) {
-		LOG_ERR("Malformed response received: %d\n", err);
-		return err;
-	}
-
-	payload = coap_packet_get_payload(&reply, &payload_len);
-	token_len = coap_header_get_token(&reply, token);
-
-	if ((token_len != sizeof(next_token)) ||
-	    (memcmp(&next_token, token, sizeof(next_token)) != 0)) {
-		LOG_ERR("Invalid token received: 0x%02x%02x\n",
-		       token[1], token[0]);
-		return 0;
-	}
+	payload = coap_packet_get_payload(reply, &payload_len);
+	(void)coap_header_get_token(reply, token);
 
 	if (payload_len > 0) {
 		snprintf(temp_buf, MIN(payload_len + 1, sizeof(temp_buf)), "%s", payload);
@@ -256,12 +502,65 @@ static int client_handle_get_response(uint8_t *buf, int received)
 	}
 
 	LOG_INF("CoAP response: Code 0x%x, Token 0x%02x%02x, Payload: %s",
-	       coap_header_get_code(&reply), token[1], token[0], temp_buf);
+	       coap_header_get_code(reply), token[1], token[0], temp_buf);
+
+#if defined(CONFIG_TRACKER_TRACK_DB)
+	int listen_ms = coap_get_option_int(reply, APP_COAP_OPTION_TRACK_DB_LISTEN);
+
+	/* Negative if the option is missing. */
+	track_db_listen_ms = CLAMP(listen_ms, 0, CONFIG_TRACKER_TRACK_DB_LISTEN);
+#endif
+}
+
+/**@brief Run the exchange on the socket until it completes.
+ *
+ * Sleeps in poll() until a message arrives, or the next retransmission or the
+ * deadline of the exchange is due.
+ */
+static int client_exchange_wait(void)
+{
+	struct pollfd fds = {
+		.fd = sock,
+		.events = POLLIN,
+	};
+
+	while (coap_exchange_process(&exchange) == -EINPROGRESS) {
+		if (poll(&fds, 1, coap_exchange_next_timeout(&exchange)) < 0) {
+			LOG_ERR("poll() failed: %d\n", errno);
+			return -errno;
+		}
+	}
+
 	return 0;
 }
 
+/**@brief CoAP exchange completion callback. */
+static void client_exchange_done(enum coap_exchange_result result,
+				 const struct coap_packet *response, void *user_data)
+{
+	enum coap_exchange_result *exchange_result = user_data;
+
+	if (result == COAP_EXCHANGE_RESPONSE) {
+		client_handle_response(response);
+	} else {
+		LOG_ERR("CoAP request failed: %s\n",
+			result == COAP_EXCHANGE_TIMEOUT ? "no response" :
+			result == COAP_EXCHANGE_RESET ? "reset by server" : "socket error");
+	}
+
+	*exchange_result = result;
+}
+
 static void lte_handler(const struct lte_lc_evt *const evt)
 {
+	lte_session_evt_handler(evt);
+#if defined(CONFIG_TRACKER_TAU_ALIGN)
+	tau_sched_evt_handler(evt);
+#endif
+#if defined(CONFIG_TRACKER_ENERGY)
+	energy_evt_handler(evt);
+#endif
+
 	switch (evt->type) {
 	case LTE_LC_EVT_NW_REG_STATUS:
 		if ((evt->nw_reg_status != LTE_LC_NW_REG_REGISTERED_HOME) &&
@@ -272,7 +571,6 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 		LOG_INF("Network registration status: %s\n",
 			evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME ?
 			"Connected - home network" : "Connected - roaming\n");
-		k_sem_give(&lte_connected);
 		break;
 	case LTE_LC_EVT_PSM_UPDATE:
 		LOG_INF("PSM parameter update: TAU: %d, Active time: %d\n",
@@ -299,6 +597,11 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 		LOG_INF("LTE cell changed: Cell ID: %d, Tracking area: %d\n",
 		       evt->cell.id, evt->cell.tac);
 		break;
+#if defined(CONFIG_TRACKER_CELL_FALLBACK)
+	case LTE_LC_EVT_NEIGHBOR_CELL_MEAS:
+		cell_location_measurement_set(&evt->cells_info);
+		break;
+#endif
 	default:
 		break;
 	}
@@ -347,14 +650,36 @@ static int modem_configure(void)
 }
 
 
-static int client_post_send(void)
+/**@brief Where client_fixes_send() takes the fixes to upload from. */
+struct fix_source {
+	int (*peek)(size_t index, struct fix_record *record);
+	size_t (*count)(void);
+	void (*consume)(size_t count);
+};
+
+static const struct fix_source ram_fixes = {
+	.peek = fix_buffer_peek,
+	.count = fix_buffer_count,
+	.consume = fix_buffer_consume,
+};
+
+#if defined(CONFIG_TRACKER_FIX_QUEUE)
+static const struct fix_source queued_fixes = {
+	.peek = fix_queue_peek,
+	.count = fix_queue_count,
+	.consume = fix_queue_consume,
+};
+#endif
+
+/**@brief Start a CoAP POST request to @p resource. */
+static int client_request_init(struct coap_packet *request, const char *resource,
+			       uint16_t content_format)
 {
-	int err,ret;
-	struct coap_packet request;
+	int err;
 
 	next_token++;
 
-	err = coap_packet_init(&request, coap_buf, sizeof(coap_buf),
+	err = coap_packet_init(request, coap_buf, sizeof(coap_buf),
 			       APP_COAP_VERSION, COAP_TYPE_CON,
 			       sizeof(next_token), (uint8_t *)&next_token,
 			       COAP_METHOD_POST, coap_next_id());
@@ -363,20 +688,108 @@ static int client_post_send(void)
 		return err;
 	}
 
-	err = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
-					(uint8_t *)CONFIG_COAP_POST_RESOURCE,
-					strlen(CONFIG_COAP_POST_RESOURCE));
+	err = coap_packet_append_option(request, COAP_OPTION_URI_PATH,
+					(uint8_t *)resource, strlen(resource));
 	if (err < 0) {
 		LOG_ERR("Failed to encode CoAP option, %d\n", err);
 		return err;
 	}
 
-   err = coap_append_option_int(&request, COAP_OPTION_CONTENT_FORMAT,
-                                COAP_CONTENT_FORMAT_TEXT_PLAIN);
-   if (err < 0) {
-      LOG_ERR("Failed to encode CoAP CONTENT_FORMAT option, %d", err);
-      return err;
-   }
+	err = coap_append_option_int(request, COAP_OPTION_CONTENT_FORMAT, content_format);
+	if (err < 0) {
+		LOG_ERR("Failed to encode CoAP CONTENT_FORMAT option, %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_TRACKER_BINARY_PAYLOAD)
+/**@brief Append as many fixes from @p source as fit, encoded with track_codec. */
+static int client_payload_append(struct coap_packet *request,
+				 const struct fix_source *source, size_t *included)
+{
+	int err;
+	struct fix_record record;
+	struct track_encoder enc;
+
+	track_encoder_init(&enc, track_buf,
+			   MIN(sizeof(track_buf), request->max_len - request->offset));
+
+	/* Leave the remaining fixes for the next request. */
+	while ((source->peek(*included, &record) == 0) &&
+	       (track_encoder_add(&enc, &record) == 0)) {
+		(*included)++;
+	}
+
+	if (*included == 0) {
+		return 0;
+	}
+
+	err = coap_packet_append_payload(request, track_buf, track_encoder_size(&enc));
+	if (err < 0) {
+		LOG_ERR("Failed to append payload, %d\n", err);
+		return err;
+	}
+
+	return 0;
+}
+#else
+/**@brief Append as many fixes from @p source as fit, one line per fix. */
+static int client_payload_append(struct coap_packet *request,
+				 const struct fix_source *source, size_t *included)
+{
+	int err,ret;
+	struct fix_record record;
+
+	while (source->peek(*included, &record) == 0) {
+		ret = snprintf(coap_sendbug, sizeof(coap_sendbug),
+			       "%.06f,%.06f,%.01f m,%04u-%02u-%02u %02u:%02u:%02u%s\n",
+			       record.latitude, record.longitude, record.accuracy,
+			       record.datetime.year, record.datetime.month, record.datetime.day,
+			       record.datetime.hour, record.datetime.minute, record.datetime.seconds,
+			       record.type == FIX_TYPE_CELL ? ",cell" : "");
+		if ((ret < 0) || ((size_t)ret >= sizeof(coap_sendbug))) {
+			LOG_ERR("snprintf failed to format string, %d\n", ret);
+			return -ENOMEM;
+		}
+
+		/* Leave the remaining fixes for the next request. */
+		if ((request->max_len - request->offset) < ret) {
+			break;
+		}
+
+		err = coap_packet_append_payload(request, (uint8_t *)coap_sendbug, ret);
+		if (err < 0) {
+			LOG_ERR("Failed to append payload, %d\n", err);
+			return err;
+		}
+		(*included)++;
+	}
+
+	return 0;
+}
+#endif
+
+/**@brief Send a CoAP POST request carrying as many fixes from @p source as fit
+ * in the CoAP message. The number of fixes added is returned in @p included.
+ * If @p last is set and the request carries all remaining fixes, it is the
+ * last request of the upload.
+ */
+static int client_post_send(const struct fix_source *source, bool last, size_t *included)
+{
+	int err;
+	struct coap_packet request;
+
+	*included = 0;
+
+	err = client_request_init(&request, CONFIG_COAP_POST_RESOURCE,
+				  IS_ENABLED(CONFIG_TRACKER_BINARY_PAYLOAD) ?
+				  COAP_CONTENT_FORMAT_APP_OCTET_STREAM :
+				  COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	if (err < 0) {
+		return err;
+	}
 
    err = coap_packet_append_option(&request, COAP_OPTION_URI_QUERY,
                                    (uint8_t *)"keep",
@@ -386,35 +799,413 @@ static int client_post_send(void)
       return err;
    }
 
+#if defined(CONFIG_TRACKER_ENERGY)
+	/* Lets the server spot devices that drain their battery. */
+	char energy_query[40];
+
+	err = energy_query_format(energy_query, sizeof(energy_query));
+	if (err > 0) {
+		err = coap_packet_append_option(&request, COAP_OPTION_URI_QUERY,
+						(uint8_t *)energy_query, err);
+	}
+	if (err < 0) {
+		LOG_ERR("Failed to encode CoAP URI-QUERY option 'energy', %d", err);
+		return err;
+	}
+#endif
+
 	err = coap_packet_append_payload_marker(&request);
 	if (err < 0) {
 		LOG_ERR("Failed to append payload marker, %d\n", err);
 		return err;
 	}
 
-   ret = snprintf (coap_sendbug, sizeof(coap_sendbug), "%.06f,%.06f\n%.01f m\n%04u-%02u-%02u %02u:%02u:%02u",
-   current_pvt.latitude, current_pvt.longitude,current_pvt.accuracy,current_pvt.datetime.year,current_pvt.datetime.month,current_pvt.datetime.day,
-   current_pvt.datetime.hour, current_pvt.datetime.minute, last_pvt.datetime.seconds);
+	/* Oldest fix first. */
+	err = client_payload_append(&request, source, included);
+	if (err < 0) {
+		return err;
+	}
+
+	if (*included == 0) {
+		return -ENOENT;
+	}
+
+	err = coap_exchange_start(&exchange, sock, &request, coap_rx_buf, sizeof(coap_rx_buf),
+				  last && (*included == source->count()),
+				  client_exchange_done, &exchange_result);
+	if (err) {
+		return err;
+	}
+
+	LOG_INF("CoAP request sent: token 0x%04x, %zu fixes, %u bytes\n",
+		next_token, *included, request.offset);
+
+	return 0;
+}
+
+/**@brief Upload all fixes of @p source over the connected socket.
+ * @p last is set if no other fixes are uploaded after them.
+ */
+static int client_fixes_send(const struct fix_source *source, bool last)
+{
+	int err;
+	size_t included;
+
+	while (source->count() > 0) {
+		err = client_post_send(source, last, &included);
+		if (err == -ENOENT) {
+			LOG_WRN("Dropping unreadable fix\n");
+			source->consume(1);
+			continue;
+		} else if (err != 0) {
+			LOG_ERR("Failed to send POST request\n");
+			return err;
+		}
+
+		err = client_exchange_wait();
+		if (err) {
+			return err;
+		}
+
+		if (exchange_result != COAP_EXCHANGE_RESPONSE) {
+			return exchange_result == COAP_EXCHANGE_TIMEOUT ? -ETIMEDOUT : -EIO;
+		}
+
+		source->consume(included);
+	}
+
+	return 0;
+}
+
+/**@brief Upload the fixes queued in flash, oldest first, then the buffered ones. */
+static int client_batch_send(void)
+{
+#if defined(CONFIG_TRACKER_FIX_QUEUE)
+	int err;
+	size_t pending = fix_queue_count();
+	int64_t start = k_uptime_get();
+
+	if (pending > 0) {
+		err = client_fixes_send(&queued_fixes, ram_fixes.count() == 0);
+		LOG_INF("Drained %zu queued fixes in %lld ms",
+			pending - fix_queue_count(), k_uptime_get() - start);
+		fix_queue_stats_log();
+		if (err) {
+			return err;
+		}
+	}
+#endif
+
+	return client_fixes_send(&ram_fixes, true);
+}
+
+#if defined(CONFIG_TRACKER_TRACK_DB)
+/**@brief Get the numeric query option "@p name=<value>", or @p def if it is missing. */
+static uint32_t client_query_get(const struct coap_option *options, int count,
+				 const char *name, uint32_t def)
+{
+	size_t name_len = strlen(name);
+	char value[11];
+	size_t len;
+
+	for (int i = 0; i < count; i++) {
+		if ((options[i].len <= name_len) || (options[i].value[name_len] != '=') ||
+		    (memcmp(options[i].value, name, name_len) != 0)) {
+			continue;
+		}
+
+		len = MIN(options[i].len - name_len - 1, sizeof(value) - 1);
+		memcpy(value, &options[i].value[name_len + 1], len);
+		value[len] = '\0';
+
+		return strtoul(value, NULL, 10);
+	}
+
+	return def;
+}
+
+/**@brief Answer a GET of the fix history with one block of the encoded fixes. */
+static int client_track_request(const struct coap_packet *request, struct coap_packet *response)
+{
+	struct coap_option options[4];
+	int count;
+	int block2;
+	uint32_t num = 0;
+	uint8_t szx = APP_TRACK_DB_SZX;
+	uint32_t from;
+	uint32_t to;
+	size_t len = 0;
+	bool more = false;
+	uint8_t code = COAP_RESPONSE_CODE_CONTENT;
+	int err;
+
+	count = coap_find_options(request, COAP_OPTION_URI_PATH, options, ARRAY_SIZE(options));
+	if ((count != 1) || (options[0].len != strlen(CONFIG_TRACKER_TRACK_DB_RESOURCE)) ||
+	    (memcmp(options[0].value, CONFIG_TRACKER_TRACK_DB_RESOURCE, options[0].len) != 0)) {
+		code = COAP_RESPONSE_CODE_NOT_FOUND;
+	} else if (coap_header_get_code(request) != COAP_METHOD_GET) {
+		code = COAP_RESPONSE_CODE_NOT_ALLOWED;
+	}
+
+	count = coap_find_options(request, COAP_OPTION_URI_QUERY, options, ARRAY_SIZE(options));
+	from = client_query_get(options, MAX(count, 0), "from", 0);
+	to = client_query_get(options, MAX(count, 0), "to", UINT32_MAX);
+	if ((code == COAP_RESPONSE_CODE_CONTENT) && (from > to)) {
+		code = COAP_RESPONSE_CODE_BAD_REQUEST;
+	}
+
+	block2 = coap_get_option_int(request, COAP_OPTION_BLOCK2);
+	if (block2 >= 0) {
+		num = block2 >> 4;
+		/* A smaller block size is used as asked, a larger one is reduced. */
+		if ((block2 & 0x7) < APP_TRACK_DB_SZX) {
+			szx = block2 & 0x7;
+		} else {
+			num <<= (block2 & 0x7) - APP_TRACK_DB_SZX;
+		}
+	}
+
+	if (code == COAP_RESPONSE_CODE_CONTENT) {
+		len = track_db_read(from, to, num << (szx + 4), track_db_buf, 1 << (szx + 4), &more);
+		if ((len == 0) && (num > 0)) {
+			/* Past the end. */
+			code = COAP_RESPONSE_CODE_BAD_OPTION;
+		}
+		LOG_INF("Fix history %u-%u, block %u: %zu bytes%s", from, to, num, len,
+			more ? "" : ", last");
+	}
+
+	err = coap_exchange_response_init(response, coap_response_buf, sizeof(coap_response_buf),
+					  request, code);
+	if ((err < 0) || (code != COAP_RESPONSE_CODE_CONTENT)) {
+		return MIN(err, 0);
+	}
+
+	err = coap_append_option_int(response, COAP_OPTION_CONTENT_FORMAT,
+				     COAP_CONTENT_FORMAT_APP_OCTET_STREAM);
+	if (err < 0) {
+		return err;
+	}
+
+	err = coap_append_option_int(response, COAP_OPTION_BLOCK2,
+				     (num << 4) | (more ? 0x8 : 0) | szx);
+	if (err < 0) {
+		return err;
+	}
+
+	if (len == 0) {
+		return 0;
+	}
+
+	err = coap_packet_append_payload_marker(response);
+	if (err < 0) {
+		return err;
+	}
+
+	return coap_packet_append_payload(response, track_db_buf, len);
+}
+#endif
+
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+/**@brief Buffer the fix held back by the track simplification, if there is one. */
+static void track_flush(void)
+{
+	struct fix_record held;
+
+	if (simplify_flush(&track, &held)) {
+		fix_buffer_put_record(&held);
+	}
+}
+#endif
+
+#if defined(CONFIG_TRACKER_CELL_FALLBACK)
+struct cell_resolve_result {
+	struct fix_record *record;
+	int err;
+};
+
+/**@brief Location resolver exchange completion callback. */
+static void client_cell_resolve_done(enum coap_exchange_result result,
+				     const struct coap_packet *response, void *user_data)
+{
+	struct cell_resolve_result *resolve = user_data;
+	const uint8_t *payload;
+	uint16_t payload_len;
+
+	exchange_result = result;
+	if (result != COAP_EXCHANGE_RESPONSE) {
+		resolve->err = -EIO;
+		return;
+	}
+
+	if (coap_header_get_code(response) != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_ERR("Location resolver error: 0x%x\n", coap_header_get_code(response));
+		resolve->err = -ENOENT;
+		return;
+	}
+
+	payload = coap_packet_get_payload(response, &payload_len);
+	resolve->err = cell_location_response_parse(payload, payload_len, resolve->record);
+	if (resolve->err) {
+		LOG_ERR("Invalid location resolver response\n");
+	}
+}
+
+/**@brief Ask the location resolver for the position of the measured cells. */
+static int client_cell_resolve(struct fix_record *record)
+{
+	int err;
+	struct coap_packet request;
+	struct cell_resolve_result resolve = {
+		.record = record,
+		.err = -EIO,
+	};
+	char payload[256];
+
+	err = client_request_init(&request, CONFIG_TRACKER_CELL_RESOLVER_RESOURCE,
+				  COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	if (err < 0) {
+		return err;
+	}
+
+	err = cell_location_request_format(payload, sizeof(payload));
 	if (err < 0) {
-		LOG_ERR("snprintf failed to format string, %d\n", err);
 		return err;
 	}
-	err = coap_packet_append_payload(&request, (uint8_t *)coap_sendbug, ret);
+
+	err = coap_packet_append_payload_marker(&request);
 	if (err < 0) {
-		LOG_ERR("Failed to append payload, %d\n", err);
+		LOG_ERR("Failed to append payload marker, %d\n", err);
 		return err;
 	}
 
-	err = send(sock, request.data, request.offset, 0);
+	err = coap_packet_append_payload(&request, (uint8_t *)payload, err);
 	if (err < 0) {
-		LOG_ERR("Failed to send CoAP request, %d\n", errno);
-		return -errno;
+		LOG_ERR("Failed to append payload, %d\n", err);
+		return err;
 	}
 
-	LOG_INF("CoAP request sent: token 0x%04x\n", next_token);
+	/* The fixes are uploaded after the lookup. */
+	err = coap_exchange_start(&exchange, sock, &request, coap_rx_buf, sizeof(coap_rx_buf),
+				  false, client_cell_resolve_done, &resolve);
+	if (err) {
+		return err;
+	}
 
-	return 0;
+	err = client_exchange_wait();
+	if (err) {
+		return err;
+	}
+
+	return resolve.err;
+}
+
+/**@brief Take a coarse position from the LTE cells after a GNSS timeout. */
+static void cell_fallback(void)
+{
+	struct fix_record record;
+
+	cell_fallback_pending = false;
+
+	if (cell_location_measure(K_SECONDS(APP_CELL_MEAS_TIMEOUT_S)) != 0) {
+		return;
+	}
+
+	if ((cell_location_lookup(&record) != 0) && (client_cell_resolve(&record) != 0)) {
+		LOG_ERR("Failed to resolve the cell location\n");
+		return;
+	}
+
+	LOG_INF("Coarse position: %.06f,%.06f (%.0f m)\n",
+		record.latitude, record.longitude, record.accuracy);
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+	/* Keep the fixes in time order, the held back GNSS fix is older. */
+	track_flush();
+#endif
+	fix_buffer_put_record(&record);
+#if defined(CONFIG_TRACKER_TRACK_DB)
+	(void)track_db_append(&record);
+#endif
+}
+#endif
+
+/**@brief Keep the fixes of a failed upload for the next connection and turn LTE off. */
+static void upload_failed(void)
+{
+#if defined(CONFIG_TRACKER_FIX_QUEUE)
+	struct fix_record record;
+
+	while (fix_buffer_peek(0, &record) == 0) {
+		if (fix_queue_append(&record) != 0) {
+			/* Keep the rest in RAM. */
+			break;
+		}
+		fix_buffer_consume(1);
+	}
+	fix_queue_stats_log();
+#endif
+
+	(void)lte_session_close(false);
+}
+
+/**@brief Adapt the GNSS configuration after a search, in the main thread. */
+static void gnss_search_done(bool timed_out)
+{
+#if defined(CONFIG_TRACKER_ADAPTIVE_INTERVAL) || defined(CONFIG_TRACKER_FIX_RETRY_LEARNED)
+	uint16_t interval = gnss_interval;
+	uint16_t retry = gnss_retry;
+
+#if defined(CONFIG_TRACKER_ADAPTIVE_INTERVAL)
+	interval = fix_interval_get();
+#endif
+#if defined(CONFIG_TRACKER_FIX_RETRY_LEARNED)
+	atomic_val_t search_ms = atomic_set(&gnss_search_time, -1);
+
+	if (search_ms >= 0) {
+		fix_retry_record(search_ms, !timed_out);
+		fix_retry_stats_log();
+		retry = fix_retry_get(interval);
+	}
+#endif
+	(void)gnss_periodic_change(interval, retry);
+#endif
+}
+
+/**@brief Handle a new fix in the main thread. */
+static void fix_process(const struct nrf_modem_gnss_pvt_data_frame *pvt)
+{
+	static uint32_t dropped;
+
+	if (pvt_ring_dropped() != dropped) {
+		dropped = pvt_ring_dropped();
+		LOG_WRN("%u PVT frames dropped in total, all slots were in use", dropped);
+	}
+
+	print_fix_data(pvt);
+
+	if (!IS_ENABLED(CONFIG_TRACKER_DEADBAND) || deadband_accept(pvt)) {
+		struct fix_record record;
+
+		fix_record_from_pvt(pvt, &record);
+#if defined(CONFIG_TRACKER_TRACK_DB)
+		/* The history keeps the fixes the simplification drops. */
+		(void)track_db_append(&record);
+#endif
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+		struct fix_record kept;
+
+		if (simplify_add(&track, &record, &kept)) {
+			fix_buffer_put_record(&kept);
+		}
+#else
+		fix_buffer_put_record(&record);
+#endif
+	}
+#if defined(CONFIG_TRACKER_ADAPTIVE_INTERVAL)
+	(void)fix_interval_update(pvt);
+#endif
 }
+
 static void button_handler(uint32_t button_state, uint32_t has_changed)
 {
 	static bool toogle = 1;
@@ -428,14 +1219,27 @@ static void button_handler(uint32_t button_state, uint32_t has_changed)
 		}
 		toogle = !toogle;
 	}
+
+	/* Switch between deactivating LTE after every upload and PSM-resident mode. */
+	if (has_changed & DK_BTN2_MSK && button_state & DK_BTN2_MSK) {
+		lte_session_psm_resident_set(!lte_session_psm_resident());
+	}
 }
 
 int main(void)
 {
 	int err;
-	int received;
+	bool timed_out;
+	bool due;
+	k_timeout_t timeout;
+	const struct nrf_modem_gnss_pvt_data_frame *pvt;
 	LOG_INF("The nRF91 Simple Tracker Version %d.%d.%d started\n",CONFIG_TRACKER_VERSION_MAJOR,CONFIG_TRACKER_VERSION_MINOR,CONFIG_TRACKER_VERSION_PATCH);
 
+#if defined(CONFIG_TRACKER_SIMPLIFY_BENCHMARK)
+	simplify_benchmark_run();
+	return 0;
+#endif
+
 	err = dk_leds_init();
 	if (err){
 		LOG_ERR("Failed to initlize the LEDs Library");
@@ -443,6 +1247,44 @@ int main(void)
 
 	device_status = status_nolte;
 
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+	simplify_init(&track, CONFIG_TRACKER_SIMPLIFY_TOLERANCE);
+#endif
+
+#if defined(CONFIG_TRACKER_TAU_ALIGN)
+	tau_sched_init(&gnss_fix_sem);
+#endif
+
+#if defined(CONFIG_NVS)
+	err = storage_init();
+	if (err) {
+		LOG_ERR("Failed to initialize storage: %d", err);
+	}
+#endif
+
+#if defined(CONFIG_TRACKER_FIX_QUEUE)
+	if (fix_queue_init() != 0) {
+		LOG_ERR("Failed to initialize the fix queue, failed uploads are kept in RAM");
+	}
+#endif
+
+#if defined(CONFIG_TRACKER_TRACK_DB)
+	if (track_db_init() != 0) {
+		LOG_ERR("Failed to load the fix history, it is kept in RAM only");
+	}
+	coap_exchange_request_handler_set(client_track_request);
+#endif
+
+#if defined(CONFIG_TRACKER_DNS_CACHE)
+	(void)dns_cache_init(CONFIG_COAP_SERVER_HOSTNAME);
+#endif
+
+#if defined(CONFIG_TRACKER_RAT_POLICY)
+	if (rat_policy_init() != 0) {
+		LOG_ERR("Failed to load the RAT statistics");
+	}
+#endif
+
 	err = modem_configure();
 	if (err) {
 		LOG_ERR("Failed to configure the modem");
@@ -459,18 +1301,72 @@ int main(void)
 	gnss_init_and_start();
 
 	while (1) {
-		k_sem_take(&gnss_fix_sem, K_FOREVER);
-		err = lte_lc_func_mode_set(LTE_LC_FUNC_MODE_NORMAL);
-		if (err != 0){
-			LOG_ERR("Failed to activate LTE");
-			break;
+		/* Wake up on a new fix, or when the oldest buffered fix gets too old. */
+		timeout = fix_buffer_flush_timeout();
+#if defined(CONFIG_TRACKER_TAU_ALIGN)
+		/* Or, while an upload waits for the TAU, when it cannot wait longer. */
+		if (!K_TIMEOUT_EQ(tau_sched_timeout(), K_FOREVER)) {
+			timeout = tau_sched_timeout();
+		}
+#endif
+		err = k_sem_take(&gnss_fix_sem, timeout);
+		if (err == 0) {
+			/* The semaphore does not count, take all published frames. */
+			while ((pvt = pvt_ring_peek()) != NULL) {
+				fix_process(pvt);
+				pvt_ring_release();
+			}
 		}
-		k_sem_take(&lte_connected, K_FOREVER);
-		if (resolve_address_lock == 0){
+
+		timed_out = atomic_clear(&gnss_timed_out);
+		gnss_search_done(timed_out);
+
+		if (IS_ENABLED(CONFIG_TRACKER_CELL_FALLBACK) && timed_out) {
+			LOG_INF("No GNSS fix, falling back to the cell location\n");
+			cell_fallback_pending = true;
+		}
+
+		due = fix_buffer_flush_due() || cell_fallback_pending;
+#if defined(CONFIG_TRACKER_TAU_ALIGN)
+		if (tau_sched_imminent()) {
+			/* The modem wakes up anyway, send whatever is buffered. */
+			due = due || (fix_buffer_count() > 0);
+		} else if (due && !cell_fallback_pending &&
+			   tau_sched_defer(fix_buffer_count() >= CONFIG_TRACKER_BATCH_HIGH_WATERMARK)) {
+			continue;
+		}
+#endif
+		if (!due) {
+			continue;
+		}
+
+#if defined(CONFIG_TRACKER_SIMPLIFY)
+		/* Upload the newest fix too, instead of holding it back. */
+		track_flush();
+		LOG_INF("Track simplification kept %u of %u fixes", track.kept, track.added);
+#endif
+		fix_buffer_flush_done();
+
+#if defined(CONFIG_TRACKER_ENERGY)
+		/* The estimate of the cycle up to this upload goes out with it. */
+		energy_cycle_end();
+#endif
+
+#if defined(CONFIG_TRACKER_TRACK_DB)
+		(void)track_db_sync();
+#endif
+
+		if (lte_session_open() != 0) {
+			upload_failed();
+			continue;
+		}
+		/* With the DNS cache, resolving is only a lookup in the cache. */
+		if (IS_ENABLED(CONFIG_TRACKER_DNS_CACHE) || (resolve_address_lock == 0)) {
 			LOG_INF("Resolving the server address\n\r");
 			if (server_resolve() != 0) {
 				LOG_ERR("Failed to resolve server name\n");
-					return 0;
+				upload_failed();
+				continue;
 			}
 			resolve_address_lock = 1;
 		}
@@ -478,34 +1374,46 @@ int main(void)
 		LOG_INF("Sending Data over LTE\r\n");
 		if (server_connect() != 0) {
 			LOG_ERR("Failed to initialize CoAP client\n");
-			return 0;
+#if defined(CONFIG_TRACKER_DNS_CACHE)
+			dns_cache_invalidate();
+#endif
+			upload_failed();
+			continue;
 		}
 
-		if (client_post_send() != 0) {
-			LOG_ERR("Failed to send GET request, exit...\n");
-			break;
+#if defined(CONFIG_TRACKER_CELL_FALLBACK)
+		if (cell_fallback_pending) {
+			cell_fallback();
 		}
+#endif
 
-		received = recv(sock, coap_buf, sizeof(coap_buf), 0);
-		if (received < 0) {
-			LOG_ERR("Error reading response\n");
-			break;
-		} else if (received == 0) {
-			LOG_ERR("Disconnected\n");
-			break;
+#if defined(CONFIG_TRACKER_TRACK_DB)
+		/* Set by the response of the last upload request. */
+		track_db_listen_ms = 0;
+#endif
+		if (client_batch_send() != 0) {
+			LOG_ERR("Failed to upload buffered fixes\n");
+#if defined(CONFIG_TRACKER_DNS_CACHE)
+			dns_cache_invalidate();
+#endif
+			(void)close(sock);
+			upload_failed();
+			continue;
 		}
 
-		err = client_handle_get_response(coap_buf, received);
-		if (err < 0) {
-			LOG_ERR("Invalid response, exit...\n");
-			break;
+#if defined(CONFIG_TRACKER_TRACK_DB)
+		if (track_db_listen_ms > 0) {
+			/* Only when asked, waiting keeps the radio on. */
+			LOG_INF("Waiting %d ms for fix history queries", track_db_listen_ms);
+			(void)coap_exchange_listen(sock, coap_rx_buf, sizeof(coap_rx_buf),
+						   track_db_listen_ms);
 		}
+#endif
 
 		(void)close(sock);
 
-		err = lte_lc_func_mode_set(LTE_LC_FUNC_MODE_DEACTIVATE_LTE);
+		err = lte_session_close(true);
 		if (err != 0){
-			LOG_ERR("Failed to decativate LTE and enable GNSS functional mode");
 			break;
 		}
 	}
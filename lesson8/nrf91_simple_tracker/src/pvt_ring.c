@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "pvt_ring.h"
+
+#define RING_SIZE CONFIG_TRACKER_PVT_RING_SIZE
+
+static struct nrf_modem_gnss_pvt_data_frame slots[RING_SIZE];
+/* Free-running counters. Only the producer writes head, only the consumer
+ * writes tail. The atomic operations order the slot accesses.
+ */
+static atomic_t head;
+static atomic_t tail;
+static uint32_t dropped;
+
+struct nrf_modem_gnss_pvt_data_frame *pvt_ring_claim(void)
+{
+	uint32_t h = (uint32_t)atomic_get(&head);
+
+	if ((h - (uint32_t)atomic_get(&tail)) >= RING_SIZE) {
+		dropped++;
+		return NULL;
+	}
+
+	return &slots[h % RING_SIZE];
+}
+
+void pvt_ring_publish(void)
+{
+	(void)atomic_inc(&head);
+}
+
+const struct nrf_modem_gnss_pvt_data_frame *pvt_ring_peek(void)
+{
+	uint32_t t = (uint32_t)atomic_get(&tail);
+
+	if (t == (uint32_t)atomic_get(&head)) {
+		return NULL;
+	}
+
+	return &slots[t % RING_SIZE];
+}
+
+void pvt_ring_release(void)
+{
+	(void)atomic_inc(&tail);
+}
+
+uint32_t pvt_ring_dropped(void)
+{
+	return dropped;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _PVT_RING_H_
+#define _PVT_RING_H_
+
+#include <stdint.h>
+#include <nrf_modem_gnss.h>
+
+/**@brief Single-producer/single-consumer ring of PVT frames.
+ *
+ * The GNSS event handler (producer, interrupt context) claims a free slot,
+ * reads the PVT frame into it and publishes it. The main thread (consumer)
+ * peeks the oldest published frame and releases it when done. Each side only
+ * writes its own index, so no lock is needed and a frame is never modified
+ * while the consumer reads it.
+ */
+
+/**@brief Producer: get a free slot, or NULL if the ring is full. */
+struct nrf_modem_gnss_pvt_data_frame *pvt_ring_claim(void);
+
+/**@brief Producer: publish the slot returned by the last pvt_ring_claim(). */
+void pvt_ring_publish(void);
+
+/**@brief Consumer: get the oldest published frame, or NULL if there is none. */
+const struct nrf_modem_gnss_pvt_data_frame *pvt_ring_peek(void);
+
+/**@brief Consumer: release the frame returned by pvt_ring_peek(). */
+void pvt_ring_release(void);
+
+/**@brief Number of frames dropped because the ring was full. */
+uint32_t pvt_ring_dropped(void);
+
+#endif /* _PVT_RING_H_ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "rat_policy.h"
+#include "storage.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+/* Layout version of the persisted statistics. */
+#define RAT_STATS_VERSION 1
+/* Try each RAT this many times before trusting the averages. */
+#define MIN_SAMPLES 3
+/* Weight of a new sample in the averages is 1/EMA_WEIGHT. */
+#define EMA_WEIGHT 8
+/* Write the statistics to flash every this many samples. */
+#define PERSIST_INTERVAL 8
+
+enum rat {
+	RAT_LTEM,
+	RAT_NBIOT,
+	RAT_COUNT
+};
+
+static const char *const rat_names[] = { "LTE-M", "NB-IoT" };
+
+struct rat_stats {
+	uint32_t uploads;
+	uint32_t failures;
+	/* Decaying averages per upload. */
+	uint32_t register_ms;
+	uint32_t rrc_ms;
+	uint32_t bytes;
+	uint32_t cost_ms;
+};
+
+static struct {
+	uint8_t version;
+	uint32_t cycles;
+	struct rat_stats rat[RAT_COUNT];
+} store;
+
+/* RAT preferred for the current attach, and preference set in the modem. */
+static enum rat chosen = RAT_LTEM;
+static int applied = -1;
+/* The preference was applied for an attach that has not been recorded yet. */
+static bool attaching;
+static uint32_t unsaved;
+
+static uint32_t ema(uint32_t average, uint32_t sample, uint32_t samples)
+{
+	if (samples <= 1) {
+		return sample;
+	}
+
+	return (uint32_t)(((uint64_t)average * (EMA_WEIGHT - 1) + sample) / EMA_WEIGHT);
+}
+
+static uint32_t samples(enum rat rat)
+{
+	return store.rat[rat].uploads + store.rat[rat].failures;
+}
+
+static void persist(void)
+{
+	int ret;
+
+	if (++unsaved < PERSIST_INTERVAL) {
+		return;
+	}
+
+	if (storage_fs() == NULL) {
+		return;
+	}
+
+	ret = nvs_write(storage_fs(), STORAGE_ID_RAT_STATS, &store, sizeof(store));
+	if (ret < 0) {
+		LOG_ERR("Failed to store the RAT statistics: %d", ret);
+		return;
+	}
+	unsaved = 0;
+}
+
+int rat_policy_init(void)
+{
+	ssize_t ret;
+
+	if (storage_fs() == NULL) {
+		return -ENODEV;
+	}
+
+	ret = nvs_read(storage_fs(), STORAGE_ID_RAT_STATS, &store, sizeof(store));
+	if ((ret != sizeof(store)) || (store.version != RAT_STATS_VERSION)) {
+		memset(&store, 0, sizeof(store));
+		store.version = RAT_STATS_VERSION;
+		return 0;
+	}
+
+	rat_policy_stats_log();
+
+	return 0;
+}
+
+void rat_policy_apply(void)
+{
+	int err;
+	enum rat other;
+
+	store.cycles++;
+	attaching = true;
+
+	if ((samples(RAT_LTEM) < MIN_SAMPLES) || (samples(RAT_NBIOT) < MIN_SAMPLES)) {
+		/* Still learning, try the RAT with fewer samples. */
+		chosen = (samples(RAT_NBIOT) < samples(RAT_LTEM)) ? RAT_NBIOT : RAT_LTEM;
+	} else {
+		chosen = (store.rat[RAT_NBIOT].cost_ms < store.rat[RAT_LTEM].cost_ms) ?
+			 RAT_NBIOT : RAT_LTEM;
+		other = (chosen == RAT_LTEM) ? RAT_NBIOT : RAT_LTEM;
+
+		if ((store.cycles % CONFIG_TRACKER_RAT_PROBE_INTERVAL) == 0) {
+			LOG_INF("Probing %s", rat_names[other]);
+			chosen = other;
+		}
+	}
+
+	if (chosen == applied) {
+		return;
+	}
+
+	err = lte_lc_system_mode_set(LTE_LC_SYSTEM_MODE_LTEM_NBIOT_GPS,
+				     chosen == RAT_LTEM ? LTE_LC_SYSTEM_MODE_PREFER_LTEM :
+							  LTE_LC_SYSTEM_MODE_PREFER_NBIOT);
+	if (err) {
+		LOG_ERR("Failed to set the RAT preference: %d", err);
+		return;
+	}
+
+	applied = chosen;
+	LOG_INF("Preferring %s", rat_names[chosen]);
+}
+
+void rat_policy_record(enum lte_lc_lte_mode mode, uint32_t register_ms,
+		       uint32_t rrc_ms, uint32_t bytes)
+{
+	enum rat rat;
+	struct rat_stats *s;
+
+	if (mode == LTE_LC_LTE_MODE_LTEM) {
+		rat = RAT_LTEM;
+	} else if (mode == LTE_LC_LTE_MODE_NBIOT) {
+		rat = RAT_NBIOT;
+	} else {
+		return;
+	}
+
+	if (attaching && (rat != chosen)) {
+		/* The modem fell back to the other RAT. */
+		LOG_WRN("%s not available", rat_names[chosen]);
+		rat_policy_failure();
+	}
+	attaching = false;
+
+	s = &store.rat[rat];
+	s->uploads++;
+	s->register_ms = ema(s->register_ms, register_ms, s->uploads);
+	s->rrc_ms = ema(s->rrc_ms, rrc_ms, s->uploads);
+	s->bytes = ema(s->bytes, bytes, s->uploads);
+	s->cost_ms = ema(s->cost_ms, register_ms + rrc_ms, samples(rat));
+
+	persist();
+}
+
+void rat_policy_failure(void)
+{
+	struct rat_stats *s = &store.rat[chosen];
+
+	attaching = false;
+	s->failures++;
+	s->cost_ms = ema(s->cost_ms, CONFIG_TRACKER_LTE_CONNECT_TIMEOUT * MSEC_PER_SEC,
+			 samples(chosen));
+
+	persist();
+}
+
+void rat_policy_stats_log(void)
+{
+	for (size_t i = 0; i < RAT_COUNT; i++) {
+		const struct rat_stats *s = &store.rat[i];
+
+		LOG_INF("%s: %u uploads, %u failed attaches, avg register %u ms, RRC %u ms, "
+			"%u bytes, cost %u ms",
+			rat_names[i], s->uploads, s->failures, s->register_ms, s->rrc_ms,
+			s->bytes, s->cost_ms);
+	}
+}
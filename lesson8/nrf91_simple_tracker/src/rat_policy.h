@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _RAT_POLICY_H_
+#define _RAT_POLICY_H_
+
+#include <stdint.h>
+#include <modem/lte_lc.h>
+
+/**@brief Choice between LTE-M and NB-IoT by the measured cost of an upload.
+ *
+ * For every upload the time to register, the RRC connected time and the
+ * CoAP bytes are recorded for the RAT that was used. The cost of an upload
+ * is the time the radio was busy, registering and connected. A failed
+ * registration costs the whole CONFIG_TRACKER_LTE_CONNECT_TIMEOUT. The
+ * averages decay, so they follow the device to a new site, and they are
+ * persisted in the storage partition.
+ *
+ * Both RATs stay enabled. The cheaper one is set as preferred, and every
+ * CONFIG_TRACKER_RAT_PROBE_INTERVAL uploads the other one is preferred
+ * once, to notice when coverage has changed.
+ */
+
+/**@brief Load the persisted statistics. */
+int rat_policy_init(void);
+
+/**@brief Set the RAT preference for the next network attach.
+ *
+ * Must be called while LTE is deactivated.
+ */
+void rat_policy_apply(void);
+
+/**@brief Record a successful upload.
+ *
+ * @param mode RAT the upload went over.
+ * @param register_ms Time to register, 0 if the modem was still registered.
+ * @param rrc_ms Time spent in RRC connected mode.
+ * @param bytes CoAP bytes sent and received.
+ */
+void rat_policy_record(enum lte_lc_lte_mode mode, uint32_t register_ms,
+		       uint32_t rrc_ms, uint32_t bytes);
+
+/**@brief Record that the network was not found with the preferred RAT. */
+void rat_policy_failure(void);
+
+/**@brief Log the statistics of both RATs. */
+void rat_policy_stats_log(void);
+
+#endif /* _RAT_POLICY_H_ */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <zephyr/kernel.h>
+
+#include "simplify.h"
+
+#define EARTH_RADIUS_M 6371000.0
+#define DEG_TO_RAD (3.14159265358979323846 / 180.0)
+
+/* Position of @p p in meters east (x) and north (y) of @p origin. */
+static void project(const struct fix_record *origin, const struct fix_record *p,
+		    double *x, double *y)
+{
+	*x = (p->longitude - origin->longitude) * DEG_TO_RAD *
+	     cos(origin->latitude * DEG_TO_RAD) * EARTH_RADIUS_M;
+	*y = (p->latitude - origin->latitude) * DEG_TO_RAD * EARTH_RADIUS_M;
+}
+
+/* Distance (m) of @p p from the segment between the anchor and @p end. */
+static double segment_distance(const struct simplify *s, const struct fix_record *end,
+			       const struct fix_record *p)
+{
+	double ex, ey, px, py, len2, t;
+
+	project(&s->anchor, end, &ex, &ey);
+	project(&s->anchor, p, &px, &py);
+
+	len2 = ex * ex + ey * ey;
+	t = (len2 > 0.0) ? CLAMP((px * ex + py * ey) / len2, 0.0, 1.0) : 0.0;
+
+	return hypot(px - t * ex, py - t * ey);
+}
+
+static bool window_fits(const struct simplify *s, const struct fix_record *end)
+{
+	for (size_t i = 0; i < s->count; i++) {
+		if (segment_distance(s, end, &s->window[i]) > s->tolerance) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void simplify_init(struct simplify *s, double tolerance)
+{
+	s->have_anchor = false;
+	s->count = 0;
+	s->tolerance = tolerance;
+	s->added = 0;
+	s->kept = 0;
+}
+
+bool simplify_add(struct simplify *s, const struct fix_record *record,
+		  struct fix_record *out)
+{
+	s->added++;
+
+	if (!s->have_anchor) {
+		s->anchor = *record;
+		s->have_anchor = true;
+		s->kept++;
+		*out = *record;
+		return true;
+	}
+
+	if ((s->count < ARRAY_SIZE(s->window)) && window_fits(s, record)) {
+		s->window[s->count++] = *record;
+		return false;
+	}
+
+	/* Keep the last fix that still fitted and restart the window from it. */
+	(void)simplify_flush(s, out);
+	s->window[s->count++] = *record;
+
+	return true;
+}
+
+bool simplify_flush(struct simplify *s, struct fix_record *out)
+{
+	if (s->count == 0) {
+		return false;
+	}
+
+	s->anchor = s->window[s->count - 1];
+	s->count = 0;
+	s->kept++;
+	*out = s->anchor;
+
+	return true;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _SIMPLIFY_H_
+#define _SIMPLIFY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fix_buffer.h"
+
+/**@brief Streaming track simplification.
+ *
+ * Opening window algorithm: starting from the last kept fix (the anchor),
+ * fixes are collected as long as all of them lie within
+ * CONFIG_TRACKER_SIMPLIFY_TOLERANCE meters of the line from the anchor to the
+ * newest fix. When a new fix breaks the tolerance, or the window holds
+ * CONFIG_TRACKER_SIMPLIFY_WINDOW fixes, the previous fix is kept and becomes
+ * the new anchor. The fixes in between are dropped.
+ *
+ * The newest fix is held back until the next one decides about it, so the
+ * stream has to be flushed before an upload.
+ */
+
+struct simplify {
+	struct fix_record anchor;
+	bool have_anchor;
+	struct fix_record window[CONFIG_TRACKER_SIMPLIFY_WINDOW];
+	size_t count;
+	double tolerance;
+	/* Fixes passed in and kept, for the statistics. */
+	uint32_t added;
+	uint32_t kept;
+};
+
+/**@brief Start a new track with a tolerance of @p tolerance meters. */
+void simplify_init(struct simplify *s, double tolerance);
+
+/**@brief Add a fix to the track.
+ *
+ * @return true if a fix was kept and copied to @p out.
+ */
+bool simplify_add(struct simplify *s, const struct fix_record *record,
+		  struct fix_record *out);
+
+/**@brief Keep the fix held back, if there is one.
+ *
+ * @return true if a fix was kept and copied to @p out.
+ */
+bool simplify_flush(struct simplify *s, struct fix_record *out);
+
+#if defined(CONFIG_TRACKER_SIMPLIFY_BENCHMARK)
+/**@brief Run the simplification over the built-in routes, and the route of
+ * the GNSS replay, and log the compression ratio and CPU time for a
+ * few tolerances.
+ */
+void simplify_benchmark_run(void);
+#endif
+
+#endif /* _SIMPLIFY_H_ */
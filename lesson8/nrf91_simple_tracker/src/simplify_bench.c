@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "simplify.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define EARTH_RADIUS_M 6371000.0
+#define RAD_TO_DEG (180.0 / 3.14159265358979323846)
+
+struct waypoint {
+	double latitude;
+	double longitude;
+};
+
+struct route {
+	const char *name;
+	const struct waypoint *waypoints;
+	size_t count;
+	/* Speed in m/s, one fix is taken per second. */
+	double speed;
+};
+
+/* Motorway with long straight legs and a few wide curves. */
+static const struct waypoint highway[] = {
+	{ 63.4305, 10.3951 }, { 63.4012, 10.4620 }, { 63.3725, 10.5402 },
+	{ 63.3611, 10.6110 }, { 63.3590, 10.7355 }, { 63.3302, 10.8201 },
+	{ 63.2855, 10.8650 }, { 63.2301, 10.8902 },
+};
+
+/* City driving, short blocks and many turns. */
+static const struct waypoint city[] = {
+	{ 63.4305, 10.3951 }, { 63.4311, 10.3990 }, { 63.4298, 10.4002 },
+	{ 63.4290, 10.4041 }, { 63.4302, 10.4055 }, { 63.4320, 10.4048 },
+	{ 63.4331, 10.4089 }, { 63.4318, 10.4120 }, { 63.4301, 10.4111 },
+	{ 63.4287, 10.4150 }, { 63.4279, 10.4201 }, { 63.4290, 10.4233 },
+};
+
+static const struct route routes[] = {
+	{ "highway", highway, ARRAY_SIZE(highway), 30.0 },
+	{ "city", city, ARRAY_SIZE(city), 10.0 },
+};
+
+static const double tolerances[] = { 5.0, 10.0, 25.0, 50.0 };
+
+#if defined(CONFIG_GNSS_REPLAY)
+/* Recorded route of the GNSS replay, see CONFIG_GNSS_REPLAY_TRACE. */
+static const char trace[] = {
+#include "gnss_trace.inc"
+};
+
+struct trace_row {
+	int64_t time;
+	bool fix;
+	double latitude;
+	double longitude;
+	float speed;
+	float heading;
+};
+
+/* Rows around the current time, and the offset of the row after them. */
+struct trace_replay {
+	size_t offset;
+	struct trace_row prev;
+	struct trace_row next;
+	int64_t time;
+};
+
+/**@brief Parse the next row of the trace, in the format of the GNSS replay.
+ *
+ * @return false at the end of the trace.
+ */
+static bool trace_row_next(struct trace_replay *t, struct trace_row *row)
+{
+	char line[128];
+	char *field[7];
+	size_t len;
+	size_t count;
+
+	while (t->offset < sizeof(trace)) {
+		len = 0;
+		while ((t->offset < sizeof(trace)) && (trace[t->offset] != '\n')) {
+			if ((trace[t->offset] != '\r') && (len < sizeof(line) - 1)) {
+				line[len++] = trace[t->offset];
+			}
+			t->offset++;
+		}
+		t->offset++;
+		line[len] = '\0';
+
+		if ((len == 0) || (line[0] == '#')) {
+			continue;
+		}
+
+		count = 0;
+		field[count++] = line;
+		while ((count < ARRAY_SIZE(field)) &&
+		       ((field[count] = strchr(field[count - 1], ',')) != NULL)) {
+			*field[count]++ = '\0';
+			count++;
+		}
+		if (count != ARRAY_SIZE(field)) {
+			continue;
+		}
+
+		*row = (struct trace_row){
+			.time = strtoll(field[0], NULL, 10),
+			.fix = (field[1][0] != '\0'),
+			.latitude = strtod(field[1], NULL),
+			.longitude = strtod(field[2], NULL),
+			.speed = strtof(field[5], NULL),
+			.heading = strtof(field[6], NULL),
+		};
+		return true;
+	}
+
+	return false;
+}
+
+/**@brief Next fix of the replayed route, one per second while it has a position.
+ *
+ * @return false past the end of the route.
+ */
+static bool trace_fix(struct trace_replay *t, struct fix_record *record)
+{
+	double f = 0.0;
+
+	for (;; t->time++) {
+		while (t->time >= t->next.time) {
+			t->prev = t->next;
+			if (!trace_row_next(t, &t->next)) {
+				return false;
+			}
+		}
+		if (t->prev.fix) {
+			break;
+		}
+	}
+
+	if (t->next.fix) {
+		f = (double)(t->time - t->prev.time) / (t->next.time - t->prev.time);
+	}
+
+	*record = (struct fix_record){
+		.latitude = t->prev.latitude + (t->next.latitude - t->prev.latitude) * f,
+		.longitude = t->prev.longitude + (t->next.longitude - t->prev.longitude) * f,
+		.accuracy = 5.0f,
+		.speed = t->prev.speed,
+		.heading = t->prev.heading,
+		.type = FIX_TYPE_GNSS,
+	};
+	t->time++;
+
+	return true;
+}
+
+static void trace_begin(struct trace_replay *t)
+{
+	*t = (struct trace_replay){ 0 };
+
+	if (trace_row_next(t, &t->next)) {
+		t->prev = t->next;
+		t->time = t->next.time;
+	}
+}
+#endif /* CONFIG_GNSS_REPLAY */
+
+/* Deterministic GNSS noise of up to +-3 m per axis. */
+static double noise_m(uint32_t *state)
+{
+	*state = *state * 1664525u + 1013904223u;
+
+	return ((double)(*state >> 8) / (double)(1 << 24) - 0.5) * 6.0;
+}
+
+/**@brief Fix number @p n of a route, or false past its end. */
+static bool route_fix(const struct route *route, uint32_t n, uint32_t *noise,
+		      struct fix_record *record)
+{
+	double travelled = n * route->speed;
+
+	for (size_t i = 1; i < route->count; i++) {
+		const struct waypoint *a = &route->waypoints[i - 1];
+		const struct waypoint *b = &route->waypoints[i];
+		double cos_lat = cos(a->latitude / RAD_TO_DEG);
+		double dx = (b->longitude - a->longitude) / RAD_TO_DEG * cos_lat * EARTH_RADIUS_M;
+		double dy = (b->latitude - a->latitude) / RAD_TO_DEG * EARTH_RADIUS_M;
+		double leg = hypot(dx, dy);
+
+		if (travelled > leg) {
+			travelled -= leg;
+			continue;
+		}
+
+		*record = (struct fix_record){
+			.latitude = a->latitude + (dy * travelled / leg + noise_m(noise)) /
+				    EARTH_RADIUS_M * RAD_TO_DEG,
+			.longitude = a->longitude + (dx * travelled / leg + noise_m(noise)) /
+				     (EARTH_RADIUS_M * cos_lat) * RAD_TO_DEG,
+			.accuracy = 5.0f,
+			.speed = route->speed,
+			.type = FIX_TYPE_GNSS,
+		};
+		return true;
+	}
+
+	return false;
+}
+
+/* Fixes fed to the simplification: a built-in route, or the replayed one if NULL. */
+struct bench_input {
+	const struct route *route;
+	uint32_t n;
+	uint32_t noise;
+#if defined(CONFIG_GNSS_REPLAY)
+	struct trace_replay trace;
+#endif
+};
+
+static void input_begin(struct bench_input *in, const struct route *route)
+{
+	in->route = route;
+	in->n = 0;
+	in->noise = 1;
+#if defined(CONFIG_GNSS_REPLAY)
+	trace_begin(&in->trace);
+#endif
+}
+
+static bool input_next(struct bench_input *in, struct fix_record *record)
+{
+#if defined(CONFIG_GNSS_REPLAY)
+	if (in->route == NULL) {
+		return trace_fix(&in->trace, record);
+	}
+#endif
+
+	return route_fix(in->route, in->n++, &in->noise, record);
+}
+
+static void benchmark_route(const char *name, const struct route *route)
+{
+	static struct simplify s;
+	static struct bench_input in;
+	struct fix_record record, out;
+
+	for (size_t t = 0; t < ARRAY_SIZE(tolerances); t++) {
+		uint64_t cycles = 0;
+		uint32_t start;
+
+		simplify_init(&s, tolerances[t]);
+		input_begin(&in, route);
+
+		while (input_next(&in, &record)) {
+			start = k_cycle_get_32();
+			(void)simplify_add(&s, &record, &out);
+			cycles += k_cycle_get_32() - start;
+		}
+		(void)simplify_flush(&s, &out);
+
+		if (s.added == 0) {
+			LOG_WRN("%s: no fixes", name);
+			return;
+		}
+
+		LOG_INF("%s, %.0f m: %u -> %u fixes (%.1fx), %llu us CPU, %llu ns per fix",
+			name, tolerances[t], s.added, s.kept,
+			(double)s.added / s.kept, k_cyc_to_us_floor64(cycles),
+			k_cyc_to_ns_floor64(cycles) / s.added);
+	}
+}
+
+void simplify_benchmark_run(void)
+{
+	LOG_INF("Track simplification benchmark, window %u fixes",
+		CONFIG_TRACKER_SIMPLIFY_WINDOW);
+
+	for (size_t r = 0; r < ARRAY_SIZE(routes); r++) {
+		benchmark_route(routes[r].name, &routes[r]);
+	}
+
+#if defined(CONFIG_GNSS_REPLAY)
+	benchmark_route("replay", NULL);
+#endif
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "storage.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define STORAGE_PARTITION storage_partition
+
+static struct nvs_fs fs;
+static bool mounted;
+
+int storage_init(void)
+{
+	int err;
+	struct flash_pages_info info;
+
+	fs.flash_device = FIXED_PARTITION_DEVICE(STORAGE_PARTITION);
+	if (!device_is_ready(fs.flash_device)) {
+		LOG_ERR("Flash device %s is not ready", fs.flash_device->name);
+		return -ENODEV;
+	}
+
+	fs.offset = FIXED_PARTITION_OFFSET(STORAGE_PARTITION);
+	err = flash_get_page_info_by_offs(fs.flash_device, fs.offset, &info);
+	if (err) {
+		LOG_ERR("Unable to get flash page info, error: %d", err);
+		return err;
+	}
+
+	fs.sector_size = info.size;
+	fs.sector_count = FIXED_PARTITION_SIZE(STORAGE_PARTITION) / info.size;
+
+	err = nvs_mount(&fs);
+	if (err) {
+		LOG_ERR("Failed to mount NVS, error: %d", err);
+		return err;
+	}
+
+	mounted = true;
+	LOG_INF("NVS mounted: %u sectors of %u bytes, %d bytes free",
+		fs.sector_count, fs.sector_size, (int)nvs_calc_free_space(&fs));
+
+	return 0;
+}
+
+struct nvs_fs *storage_fs(void)
+{
+	return mounted ? &fs : NULL;
+}
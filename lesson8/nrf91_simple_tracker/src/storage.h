@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <zephyr/fs/nvs.h>
+
+/* NVS ids used by the tracker modules. Each module owns its own range. */
+#define STORAGE_ID_FIX_QUEUE_READ	1
+#define STORAGE_ID_DNS_ADDRESS		2
+#define STORAGE_ID_RAT_STATS		3
+#define STORAGE_ID_FIX_QUEUE_BASE	0x1000
+#define STORAGE_ID_TRACK_DB_BASE	0x2000
+
+/**@brief Mount the NVS file system on the storage partition. */
+int storage_init(void);
+
+/**@brief Get the mounted NVS file system, or NULL if it is not mounted. */
+struct nvs_fs *storage_fs(void);
+
+#endif /* _STORAGE_H_ */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "lte_session.h"
+#include "tau_sched.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+static struct k_sem *wake_sem;
+static atomic_t imminent;
+
+/* Written by the LTE handler, read by the main thread. */
+static struct k_spinlock lock;
+/* Granted TAU period (s), -1 if PSM is not granted. */
+static int tau = -1;
+/* Uptime (ms) of the last RRC release while registered, 0 if unknown. */
+static int64_t last_release;
+
+/* Uptime (ms) at which the deferred upload first became due, 0 if none. */
+static int64_t deferred_since;
+static int64_t deadline;
+
+static uint32_t deferred_uploads;
+static uint32_t tau_uploads;
+
+void tau_sched_init(struct k_sem *wake)
+{
+	wake_sem = wake;
+}
+
+void tau_sched_evt_handler(const struct lte_lc_evt *const evt)
+{
+	k_spinlock_key_t key;
+
+	switch (evt->type) {
+	case LTE_LC_EVT_PSM_UPDATE:
+		key = k_spin_lock(&lock);
+		tau = (evt->psm_cfg.active_time >= 0) ? evt->psm_cfg.tau : -1;
+		k_spin_unlock(&lock, key);
+		break;
+	case LTE_LC_EVT_RRC_UPDATE:
+		if (evt->rrc_mode == LTE_LC_RRC_MODE_IDLE) {
+			key = k_spin_lock(&lock);
+			last_release = k_uptime_get();
+			k_spin_unlock(&lock, key);
+		}
+		break;
+	case LTE_LC_EVT_NW_REG_STATUS:
+		if ((evt->nw_reg_status != LTE_LC_NW_REG_REGISTERED_HOME) &&
+		    (evt->nw_reg_status != LTE_LC_NW_REG_REGISTERED_ROAMING)) {
+			key = k_spin_lock(&lock);
+			last_release = 0;
+			k_spin_unlock(&lock, key);
+		}
+		break;
+	case LTE_LC_EVT_TAU_PRE_WARNING:
+		LOG_INF("TAU due in %u ms", CONFIG_LTE_LC_TAU_PRE_WARNING_TIME_MS);
+		atomic_set(&imminent, 1);
+		if (wake_sem) {
+			k_sem_give(wake_sem);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* Uptime (ms) at which the next TAU is expected, 0 if unknown. */
+static int64_t next_tau(void)
+{
+	int64_t next = 0;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if ((tau > 0) && (last_release != 0)) {
+		next = last_release + (int64_t)tau * MSEC_PER_SEC;
+	}
+	k_spin_unlock(&lock, key);
+
+	return next;
+}
+
+bool tau_sched_imminent(void)
+{
+	if (!atomic_clear(&imminent)) {
+		return false;
+	}
+
+	/* Only counts when this wake-up carries an upload, see tau_sched_defer(). */
+	if (deferred_since != 0) {
+		tau_uploads++;
+		LOG_INF("Uploading with the TAU, %u of %u deferred uploads so far",
+			tau_uploads, deferred_uploads);
+	}
+	deferred_since = 0;
+
+	return true;
+}
+
+bool tau_sched_defer(bool urgent)
+{
+	int64_t now = k_uptime_get();
+	int64_t tau_at = next_tau();
+
+	if (urgent || !lte_session_psm_resident() || (tau_at == 0)) {
+		deferred_since = 0;
+		return false;
+	}
+
+	if (deferred_since == 0) {
+		if (tau_at > now + (int64_t)CONFIG_TRACKER_TAU_ALIGN_MAX_DELAY * MSEC_PER_SEC) {
+			/* The TAU is too far away. */
+			return false;
+		}
+
+		deferred_since = now;
+		deadline = tau_at;
+		deferred_uploads++;
+		LOG_INF("Deferring the upload to the TAU in %lld s", (tau_at - now) / MSEC_PER_SEC);
+	}
+
+	if (now >= deadline) {
+		/* No pre-warning came, the estimate was off. */
+		deferred_since = 0;
+		return false;
+	}
+
+	return true;
+}
+
+k_timeout_t tau_sched_timeout(void)
+{
+	int64_t now = k_uptime_get();
+
+	if (deferred_since == 0) {
+		return K_FOREVER;
+	}
+
+	return (deadline > now) ? K_MSEC(deadline - now) : K_NO_WAIT;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _TAU_SCHED_H_
+#define _TAU_SCHED_H_
+
+#include <stdbool.h>
+#include <zephyr/kernel.h>
+#include <modem/lte_lc.h>
+
+/**@brief Upload scheduling around the periodic tracking area update (TAU).
+ *
+ * While the modem sleeps in PSM it wakes up every TAU period to update the
+ * network, unless it had a connection in the meantime. An upload sent just
+ * before the TAU is due replaces that update, so deferring a non-urgent
+ * upload to the TAU saves one RRC connection.
+ *
+ * The next TAU is expected one granted TAU period after the last RRC
+ * connection was released. The TAU pre-warning of the modem marks the
+ * moment to upload.
+ */
+
+/**@brief Set the semaphore given when a TAU is imminent. */
+void tau_sched_init(struct k_sem *wake);
+
+/**@brief Pass LTE link controller events to the scheduler.
+ *
+ * Called from the LTE event handler.
+ */
+void tau_sched_evt_handler(const struct lte_lc_evt *const evt);
+
+/**@brief Check, and clear, whether a TAU is imminent. */
+bool tau_sched_imminent(void);
+
+/**@brief Check whether a due upload should wait for the next TAU.
+ *
+ * An upload is deferred when the next TAU is expected within
+ * CONFIG_TRACKER_TAU_ALIGN_MAX_DELAY seconds of the moment the upload
+ * first became due. Urgent uploads are never deferred.
+ *
+ * @return true if the upload should wait, see tau_sched_timeout().
+ */
+bool tau_sched_defer(bool urgent);
+
+/**@brief Time left until a deferred upload has to be sent anyway. */
+k_timeout_t tau_sched_timeout(void);
+
+#endif /* _TAU_SCHED_H_ */
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "track_codec.h"
+
+#define COORD_SCALE 1e6
+
+/* Days since 1970-01-01 of a date in the proleptic Gregorian calendar. */
+static int64_t days_from_civil(int64_t year, unsigned int month, unsigned int day)
+{
+	int64_t era;
+	unsigned int yoe, doy, doe;
+
+	year -= (month <= 2) ? 1 : 0;
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = (unsigned int)(year - era * 400);
+	doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+static int64_t record_time(const struct fix_record *record)
+{
+	const struct nrf_modem_gnss_datetime *dt = &record->datetime;
+
+	if (dt->year == 0) {
+		return 0;
+	}
+
+	return days_from_civil(dt->year, dt->month, dt->day) * 86400 +
+	       dt->hour * 3600 + dt->minute * 60 + dt->seconds;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static size_t varint_put(uint8_t *buf, uint64_t value)
+{
+	size_t len = 0;
+
+	while (value >= 0x80) {
+		buf[len++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buf[len++] = (uint8_t)value;
+
+	return len;
+}
+
+void track_encoder_init(struct track_encoder *enc, uint8_t *buf, size_t len)
+{
+	*enc = (struct track_encoder){
+		.buf = buf,
+		.len = len,
+	};
+
+	if (len > 0) {
+		buf[enc->offset++] = TRACK_CODEC_VERSION;
+	}
+}
+
+void track_point_from_record(const struct fix_record *record, struct track_point *point)
+{
+	*point = (struct track_point){
+		.latitude = (int32_t)lround(record->latitude * COORD_SCALE),
+		.longitude = (int32_t)lround(record->longitude * COORD_SCALE),
+		.time = (uint32_t)record_time(record),
+		.accuracy = (record->accuracy > 0.0f) ?
+			    (uint16_t)MIN(ceilf(record->accuracy), UINT16_MAX) : 0,
+		.cell = (record->type == FIX_TYPE_CELL) ? 1 : 0,
+	};
+}
+
+/* Encode @p point relative to the previous point of @p enc. */
+static size_t point_encode(const struct track_encoder *enc, const struct track_point *point,
+			   uint8_t *buf)
+{
+	size_t len = 0;
+
+	len += varint_put(&buf[len], zigzag((int64_t)point->latitude - enc->latitude));
+	len += varint_put(&buf[len], zigzag((int64_t)point->longitude - enc->longitude));
+	len += varint_put(&buf[len], zigzag((int64_t)point->time - enc->time));
+	len += varint_put(&buf[len], ((uint64_t)point->accuracy << 1) | point->cell);
+
+	return len;
+}
+
+static void point_commit(struct track_encoder *enc, const struct track_point *point)
+{
+	enc->latitude = point->latitude;
+	enc->longitude = point->longitude;
+	enc->time = point->time;
+}
+
+int track_encoder_add_point(struct track_encoder *enc, const struct track_point *point)
+{
+	uint8_t buf[TRACK_CODEC_POINT_MAX_LEN];
+	size_t len;
+
+	if (enc->offset == 0) {
+		return -ENOMEM;
+	}
+
+	len = point_encode(enc, point, buf);
+	if (len > (enc->len - enc->offset)) {
+		return -ENOMEM;
+	}
+
+	memcpy(&enc->buf[enc->offset], buf, len);
+	enc->offset += len;
+	point_commit(enc, point);
+
+	return 0;
+}
+
+int track_encoder_add(struct track_encoder *enc, const struct fix_record *record)
+{
+	struct track_point point;
+
+	track_point_from_record(record, &point);
+
+	return track_encoder_add_point(enc, &point);
+}
+
+size_t track_encoder_next(struct track_encoder *enc, const struct track_point *point,
+			  uint8_t *buf)
+{
+	size_t len = point_encode(enc, point, buf);
+
+	point_commit(enc, point);
+
+	return len;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _TRACK_CODEC_H_
+#define _TRACK_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fix_buffer.h"
+
+/**@brief Compact binary encoding of a batch of track points.
+ *
+ * A batch starts with the format version byte TRACK_CODEC_VERSION, followed
+ * by one record per point, oldest first. Each record holds four unsigned
+ * LEB128 varints:
+ *
+ *  - latitude, in 1e-6 degrees
+ *  - longitude, in 1e-6 degrees
+ *  - time, in seconds since 1970-01-01 UTC (0 if unknown)
+ *  - accuracy in meters (rounded up, at most 65535), shifted left by one,
+ *    with bit 0 set for a coarse cell-based position
+ *
+ * Latitude, longitude and time are zig-zag encoded differences to the
+ * previous point of the batch. The first point is relative to zero, so
+ * every batch can be decoded on its own.
+ */
+
+#define TRACK_CODEC_VERSION 1
+
+/* Worst case size of one encoded point. */
+#define TRACK_CODEC_POINT_MAX_LEN (5 + 5 + 10 + 5)
+
+/**@brief Track point in the units of the encoding. */
+struct track_point {
+	/* 1e-6 degrees. */
+	int32_t latitude;
+	int32_t longitude;
+	/* Seconds since 1970-01-01 UTC, 0 if unknown. */
+	uint32_t time;
+	/* Meters, rounded up. */
+	uint16_t accuracy;
+	/* Coarse cell-based position. */
+	uint8_t cell;
+	uint8_t reserved;
+};
+
+struct track_encoder {
+	uint8_t *buf;
+	size_t len;
+	size_t offset;
+	/* Previous point. */
+	int32_t latitude;
+	int32_t longitude;
+	int64_t time;
+};
+
+/**@brief Convert a fix to the units of the encoding. */
+void track_point_from_record(const struct fix_record *record, struct track_point *point);
+
+/**@brief Start a new batch in @p buf.
+ *
+ * With a zero @p len only the encoder state is initialized, for use with
+ * track_encoder_next().
+ */
+void track_encoder_init(struct track_encoder *enc, uint8_t *buf, size_t len);
+
+/**@brief Append a point to the batch.
+ *
+ * @return 0 on success, -ENOMEM if the point does not fit. The batch is left
+ *	   unchanged in that case.
+ */
+int track_encoder_add(struct track_encoder *enc, const struct fix_record *record);
+
+/**@brief Append a point to the batch, see track_encoder_add(). */
+int track_encoder_add_point(struct track_encoder *enc, const struct track_point *point);
+
+/**@brief Encode the point following the previous one into @p buf.
+ *
+ * For producing a batch piecewise, without the buffer of the encoder. The
+ * version byte is left to the caller.
+ *
+ * @param buf At least TRACK_CODEC_POINT_MAX_LEN bytes.
+ * @return Length of the encoded point.
+ */
+size_t track_encoder_next(struct track_encoder *enc, const struct track_point *point,
+			  uint8_t *buf);
+
+/**@brief Number of bytes of the batch encoded so far. */
+static inline size_t track_encoder_size(const struct track_encoder *enc)
+{
+	return enc->offset;
+}
+
+#endif /* _TRACK_CODEC_H_ */
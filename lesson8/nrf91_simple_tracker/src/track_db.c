@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "storage.h"
+#include "track_codec.h"
+#include "track_db.h"
+
+LOG_MODULE_DECLARE(Cellfund_Project);
+
+#define BLOCKS CONFIG_TRACKER_TRACK_DB_BLOCKS
+#define BLOCK_POINTS CONFIG_TRACKER_TRACK_DB_BLOCK_POINTS
+
+BUILD_ASSERT(STORAGE_ID_TRACK_DB_BASE + BLOCKS <= UINT16_MAX,
+	     "Track database does not fit in the NVS id space");
+
+/* Block header, also the index entry of the block. */
+struct block_header {
+	uint32_t seq;
+	/* Time range of the points, in seconds since 1970-01-01 UTC. */
+	uint32_t min_time;
+	uint32_t max_time;
+	uint16_t count;
+	uint16_t reserved;
+};
+
+/* Block as stored in flash, only the used points are written. */
+struct block {
+	struct block_header header;
+	struct track_point points[BLOCK_POINTS];
+};
+
+/* Position of a query in the encoded batch. */
+struct cursor {
+	uint32_t from;
+	uint32_t to;
+	/* Offset of the next byte to copy. */
+	size_t offset;
+	/* Next point to encode. */
+	uint32_t seq;
+	uint16_t index;
+	struct track_encoder enc;
+	/* Encoded bytes not copied yet, the version byte or one point. */
+	uint8_t pending[TRACK_CODEC_POINT_MAX_LEN];
+	uint8_t pending_len;
+	uint8_t pending_pos;
+	bool valid;
+};
+
+/* Headers of the blocks in flash, by slot. A zero count marks a free slot. */
+static struct block_header headers[BLOCKS];
+/* Block being filled. */
+static struct block head;
+static bool head_dirty;
+/* Last block read from flash. */
+static struct block scratch;
+static bool scratch_valid;
+
+/* Current query, and its state at the start of the last read, to serve a
+ * repeated read without encoding the batch from the start.
+ */
+static struct cursor cursor;
+static struct cursor saved;
+
+static uint16_t slot(uint32_t seq)
+{
+	return seq % BLOCKS;
+}
+
+static size_t block_size(const struct block *block)
+{
+	return sizeof(block->header) + block->header.count * sizeof(block->points[0]);
+}
+
+/* Sequence number of the oldest block that can still be stored. */
+static uint32_t oldest_seq(void)
+{
+	return (head.header.seq >= BLOCKS) ? head.header.seq - BLOCKS + 1 : 0;
+}
+
+static int block_read(uint32_t seq, struct block *block)
+{
+	ssize_t ret;
+
+	ret = nvs_read(storage_fs(), STORAGE_ID_TRACK_DB_BASE + slot(seq), block, sizeof(*block));
+	if ((ret < (ssize_t)sizeof(block->header)) || (block->header.seq != seq) ||
+	    (block->header.count > BLOCK_POINTS) || (ret < (ssize_t)block_size(block))) {
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+static int head_store(void)
+{
+	ssize_t ret;
+
+	if (storage_fs() == NULL) {
+		return -ENODEV;
+	}
+
+	ret = nvs_write(storage_fs(), STORAGE_ID_TRACK_DB_BASE + slot(head.header.seq),
+			&head, block_size(&head));
+	if (ret < 0) {
+		LOG_ERR("Failed to store track block %u, error: %d", head.header.seq, (int)ret);
+		return ret;
+	}
+
+	headers[slot(head.header.seq)] = head.header;
+	if (scratch.header.seq == head.header.seq) {
+		scratch_valid = false;
+	}
+	head_dirty = false;
+
+	return 0;
+}
+
+int track_db_init(void)
+{
+	struct nvs_fs *fs = storage_fs();
+	uint32_t newest = 0;
+	bool found = false;
+	ssize_t ret;
+
+	if (fs == NULL) {
+		return -ENODEV;
+	}
+
+	for (uint16_t i = 0; i < BLOCKS; i++) {
+		/* Only the header is copied. */
+		ret = nvs_read(fs, STORAGE_ID_TRACK_DB_BASE + i, &headers[i], sizeof(headers[i]));
+		if ((ret < (ssize_t)sizeof(headers[i])) || (slot(headers[i].seq) != i) ||
+		    (headers[i].count == 0) || (headers[i].count > BLOCK_POINTS)) {
+			memset(&headers[i], 0, sizeof(headers[i]));
+			continue;
+		}
+
+		if (!found || ((int32_t)(headers[i].seq - newest) > 0)) {
+			newest = headers[i].seq;
+			found = true;
+		}
+	}
+
+	memset(&head, 0, sizeof(head));
+	if (found) {
+		/* Continue filling the newest block if it has room left. */
+		if ((headers[slot(newest)].count == BLOCK_POINTS) || (block_read(newest, &head) != 0)) {
+			memset(&head, 0, sizeof(head));
+			head.header.seq = newest + 1;
+		}
+	}
+
+	track_db_stats_log();
+
+	return 0;
+}
+
+int track_db_append(const struct fix_record *record)
+{
+	struct track_point point;
+	struct block_header *h = &head.header;
+	uint32_t seq = h->seq;
+	int err;
+
+	track_point_from_record(record, &point);
+	if (point.time == 0) {
+		/* Could not be found by time. */
+		return -EINVAL;
+	}
+
+	if (h->count == 0) {
+		h->min_time = point.time;
+		h->max_time = point.time;
+	} else {
+		h->min_time = MIN(h->min_time, point.time);
+		h->max_time = MAX(h->max_time, point.time);
+	}
+	head.points[h->count++] = point;
+	head_dirty = true;
+
+	if (h->count < BLOCK_POINTS) {
+		return 0;
+	}
+
+	err = head_store();
+
+	/* On failure the points of the block are lost. */
+	memset(&head, 0, sizeof(head));
+	head.header.seq = seq + 1;
+
+	return err;
+}
+
+int track_db_sync(void)
+{
+	if (!head_dirty) {
+		return 0;
+	}
+
+	return head_store();
+}
+
+/* Header of block @p seq, NULL if the block is not stored. */
+static const struct block_header *header_get(uint32_t seq)
+{
+	const struct block_header *h;
+
+	if (seq == head.header.seq) {
+		return &head.header;
+	}
+
+	h = &headers[slot(seq)];
+
+	return ((h->count > 0) && (h->seq == seq)) ? h : NULL;
+}
+
+static const struct block *block_get(uint32_t seq)
+{
+	if (seq == head.header.seq) {
+		return &head;
+	}
+
+	if (!scratch_valid || (scratch.header.seq != seq)) {
+		scratch_valid = (block_read(seq, &scratch) == 0);
+		if (!scratch_valid) {
+			LOG_WRN("Track block %u is unreadable", seq);
+			return NULL;
+		}
+	}
+
+	return &scratch;
+}
+
+static void cursor_start(struct cursor *c, uint32_t from, uint32_t to)
+{
+	*c = (struct cursor){
+		.from = from,
+		.to = to,
+		.seq = oldest_seq(),
+		.pending = { TRACK_CODEC_VERSION },
+		.pending_len = 1,
+		.valid = true,
+	};
+
+	track_encoder_init(&c->enc, NULL, 0);
+}
+
+/* Make sure there are pending bytes. Returns false at the end of the batch. */
+static bool cursor_fill(struct cursor *c)
+{
+	const struct block_header *h;
+	const struct block *block;
+
+	if (c->pending_pos < c->pending_len) {
+		return true;
+	}
+
+	for (; (int32_t)(head.header.seq - c->seq) >= 0; c->seq++, c->index = 0) {
+		h = header_get(c->seq);
+		if ((h == NULL) || (h->max_time < c->from) || (h->min_time > c->to)) {
+			continue;
+		}
+
+		block = block_get(c->seq);
+		if (block == NULL) {
+			continue;
+		}
+
+		while (c->index < block->header.count) {
+			const struct track_point *point = &block->points[c->index++];
+
+			if ((point->time >= c->from) && (point->time <= c->to)) {
+				c->pending_len = track_encoder_next(&c->enc, point, c->pending);
+				c->pending_pos = 0;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/* Copy up to @p len pending bytes to @p buf, or skip them if @p buf is NULL. */
+static size_t cursor_take(struct cursor *c, uint8_t *buf, size_t len)
+{
+	len = MIN(len, (size_t)(c->pending_len - c->pending_pos));
+	if (buf != NULL) {
+		memcpy(buf, &c->pending[c->pending_pos], len);
+	}
+	c->pending_pos += len;
+	c->offset += len;
+
+	return len;
+}
+
+static bool cursor_matches(const struct cursor *c, uint32_t from, uint32_t to, size_t offset)
+{
+	return c->valid && (c->from == from) && (c->to == to) && (c->offset <= offset);
+}
+
+size_t track_db_read(uint32_t from, uint32_t to, size_t offset, uint8_t *buf, size_t len,
+		     bool *more)
+{
+	size_t copied = 0;
+
+	if (!cursor_matches(&cursor, from, to, offset)) {
+		if (cursor_matches(&saved, from, to, offset)) {
+			cursor = saved;
+		} else {
+			cursor_start(&cursor, from, to);
+		}
+	}
+
+	while ((cursor.offset < offset) && cursor_fill(&cursor)) {
+		(void)cursor_take(&cursor, NULL, offset - cursor.offset);
+	}
+
+	saved = cursor;
+
+	while ((copied < len) && cursor_fill(&cursor)) {
+		copied += cursor_take(&cursor, &buf[copied], len - copied);
+	}
+
+	*more = cursor_fill(&cursor);
+
+	return copied;
+}
+
+void track_db_stats_log(void)
+{
+	uint32_t points = head.header.count;
+	uint32_t blocks = 0;
+
+	for (uint32_t seq = oldest_seq(); seq != head.header.seq; seq++) {
+		if (header_get(seq) != NULL) {
+			points += headers[slot(seq)].count;
+			blocks++;
+		}
+	}
+
+	LOG_INF("Track database: %u points in %u blocks, %u in the open block",
+		points, blocks, head.header.count);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _TRACK_DB_H_
+#define _TRACK_DB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fix_buffer.h"
+
+/**@brief Time-indexed history of the fixes in flash.
+ *
+ * Fixes are collected in blocks of CONFIG_TRACKER_TRACK_DB_BLOCK_POINTS
+ * points, and every block is one NVS entry. The blocks form a ring of
+ * CONFIG_TRACKER_TRACK_DB_BLOCKS entries, so the oldest block is overwritten
+ * when the ring is full. The headers of the blocks, with the time range of
+ * their points, are kept in RAM as the index, so a range query only reads
+ * the blocks that overlap it.
+ *
+ * The block being filled is kept in RAM and written when it is full, or
+ * with track_db_sync().
+ *
+ * A query returns the matching points, oldest first, as one track_codec
+ * batch. It is read in pieces by byte offset. Reading the pieces in order
+ * continues where the previous read stopped.
+ */
+
+/**@brief Load the index from flash. Requires storage_init(). */
+int track_db_init(void);
+
+/**@brief Add a fix to the history.
+ *
+ * @return 0 on success, -EINVAL if the fix has no time, or a negative error
+ *	   code if a full block could not be written.
+ */
+int track_db_append(const struct fix_record *record);
+
+/**@brief Write the block being filled to flash, if it has new points. */
+int track_db_sync(void);
+
+/**@brief Read part of the encoded points between @p from and @p to.
+ *
+ * @param from Oldest time, in seconds since 1970-01-01 UTC.
+ * @param to Newest time, in seconds since 1970-01-01 UTC.
+ * @param offset Offset in the encoded batch.
+ * @param buf Buffer for the encoded batch.
+ * @param len Size of @p buf.
+ * @param more Set if the batch continues after the copied bytes.
+ *
+ * @return Number of bytes copied, less than @p len only at the end.
+ */
+size_t track_db_read(uint32_t from, uint32_t to, size_t offset, uint8_t *buf, size_t len,
+		     bool *more);
+
+/**@brief Log the size of the history. */
+void track_db_stats_log(void);
+
+#endif /* _TRACK_DB_H_ */
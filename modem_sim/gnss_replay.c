@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Replay of a recorded route through the nrf_modem_gnss API.
+ *
+ * Only the calls used by the course samples are implemented. The GNSS is
+ * driven by a delayable work item that runs once per second of route time
+ * while searching, and the event handler is called from the system work
+ * queue instead of an interrupt.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <nrf_modem_gnss.h>
+
+LOG_MODULE_REGISTER(gnss_replay, CONFIG_GNSS_REPLAY_LOG_LEVEL);
+
+#define SPEEDUP CONFIG_GNSS_REPLAY_SPEEDUP
+/* Satellites reported while searching and with a fix. */
+#define SV_SEARCHING 3
+#define SV_FIX 8
+
+static const char trace[] = {
+#include "gnss_trace.inc"
+};
+
+struct row {
+	/* Seconds since 1970-01-01 UTC. */
+	int64_t time;
+	bool fix;
+	double latitude;
+	double longitude;
+	float altitude;
+	float accuracy;
+	float speed;
+	float heading;
+};
+
+/* Rows around the current time, and the offset of the row after them. */
+static struct row prev;
+static struct row next;
+static size_t trace_offset;
+static bool trace_ended;
+
+/* Route time (ms) at the uptime of the first start. */
+static int64_t route_start;
+static int64_t uptime_start = -1;
+
+static nrf_modem_gnss_event_handler_type_t event_handler;
+static uint16_t fix_interval = 1;
+static uint16_t fix_retry = 60;
+static bool running;
+static bool fixed_once;
+/* Route time (ms) of the start of the current search, -1 while sleeping. */
+static int64_t search_start;
+/* Route time (ms) since the route has a position in this search, -1 if none. */
+static int64_t signal_since;
+/* Fix acquired, kept while the route has a position. */
+static bool tracking;
+
+static struct nrf_modem_gnss_pvt_data_frame pvt;
+/* The API may be called from any thread, and from the event handler. */
+static K_MUTEX_DEFINE(replay_lock);
+
+static void replay_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(replay_work, replay_work_fn);
+
+static int line_parse(char *line, struct row *row)
+{
+	char *field[7];
+	size_t count = 0;
+	char *pos = line;
+
+	field[count++] = pos;
+	while ((count < ARRAY_SIZE(field)) && ((pos = strchr(pos, ',')) != NULL)) {
+		*pos++ = '\0';
+		field[count++] = pos;
+	}
+
+	if (count != ARRAY_SIZE(field)) {
+		return -EINVAL;
+	}
+
+	*row = (struct row){
+		.time = strtoll(field[0], NULL, 10),
+		.fix = (field[1][0] != '\0'),
+	};
+
+	if (row->fix) {
+		row->latitude = strtod(field[1], NULL);
+		row->longitude = strtod(field[2], NULL);
+		row->altitude = strtof(field[3], NULL);
+		row->accuracy = strtof(field[4], NULL);
+		row->speed = strtof(field[5], NULL);
+		row->heading = strtof(field[6], NULL);
+	}
+
+	return 0;
+}
+
+/* Parse the next row of the trace. Returns false at the end. */
+static bool row_next(struct row *row)
+{
+	char line[128];
+	size_t len;
+
+	while (trace_offset < sizeof(trace)) {
+		len = 0;
+		while ((trace_offset < sizeof(trace)) && (trace[trace_offset] != '\n')) {
+			if ((trace[trace_offset] != '\r') && (len < sizeof(line) - 1)) {
+				line[len++] = trace[trace_offset];
+			}
+			trace_offset++;
+		}
+		trace_offset++;
+		line[len] = '\0';
+
+		if ((len == 0) || (line[0] == '#')) {
+			continue;
+		}
+
+		if (line_parse(line, row) == 0) {
+			return true;
+		}
+
+		LOG_WRN("Invalid trace row ignored");
+	}
+
+	return false;
+}
+
+static int64_t route_now(void)
+{
+	return route_start + (k_uptime_get() - uptime_start) * SPEEDUP;
+}
+
+/* Route time to uptime. */
+static k_timeout_t route_delay(int64_t ms)
+{
+	return K_MSEC(MAX(ms, 0) / SPEEDUP);
+}
+
+static void datetime_set(struct nrf_modem_gnss_datetime *dt, int64_t ms)
+{
+	/* Civil date from the days since 1970-01-01, proleptic Gregorian calendar. */
+	int64_t secs = ms / MSEC_PER_SEC;
+	int64_t days = secs / 86400 + 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	unsigned int doe = (unsigned int)(days - era * 146097);
+	unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned int mp = (5 * doy + 2) / 153;
+	unsigned int month = (mp < 10) ? mp + 3 : mp - 9;
+
+	dt->year = (uint16_t)(yoe + era * 400 + (month <= 2 ? 1 : 0));
+	dt->month = month;
+	dt->day = doy - (153 * mp + 2) / 5 + 1;
+	dt->hour = (secs % 86400) / 3600;
+	dt->minute = (secs % 3600) / 60;
+	dt->seconds = secs % 60;
+	dt->ms = ms % MSEC_PER_SEC;
+}
+
+/* Position on the route at @p now, false if there is no fix. */
+static bool route_position(int64_t now, struct row *pos)
+{
+	float t;
+
+	while (!trace_ended && (next.time * MSEC_PER_SEC <= now)) {
+		prev = next;
+		if (!row_next(&next)) {
+			LOG_INF("End of the GNSS trace, no more fixes");
+			trace_ended = true;
+		}
+	}
+
+	if (trace_ended || !prev.fix) {
+		return false;
+	}
+
+	*pos = prev;
+	if (next.fix && (next.time > prev.time)) {
+		t = (float)(now - prev.time * MSEC_PER_SEC) / ((next.time - prev.time) * MSEC_PER_SEC);
+		pos->latitude += (next.latitude - prev.latitude) * t;
+		pos->longitude += (next.longitude - prev.longitude) * t;
+		pos->altitude += (next.altitude - prev.altitude) * t;
+	}
+
+	return true;
+}
+
+static void frame_fill(int64_t now, const struct row *pos)
+{
+	size_t svs = pos ? SV_FIX : SV_SEARCHING;
+
+	memset(&pvt, 0, sizeof(pvt));
+	datetime_set(&pvt.datetime, now);
+
+	for (size_t i = 0; i < svs; i++) {
+		pvt.sv[i].sv = 2 + 3 * i;
+		pvt.sv[i].signal = NRF_MODEM_GNSS_SV_TYPE_GPSL1CA;
+		pvt.sv[i].cn0 = 350 + 15 * i;
+		pvt.sv[i].elevation = 15 + 8 * i;
+		pvt.sv[i].azimuth = 45 * i;
+		pvt.sv[i].flags = pos ? NRF_MODEM_GNSS_SV_FLAG_USED_IN_FIX : 0;
+	}
+
+	if (pos == NULL) {
+		return;
+	}
+
+	pvt.latitude = pos->latitude;
+	pvt.longitude = pos->longitude;
+	pvt.altitude = pos->altitude;
+	pvt.accuracy = pos->accuracy;
+	pvt.altitude_accuracy = pos->accuracy * 1.5f;
+	pvt.speed = pos->speed;
+	pvt.speed_accuracy = 0.1f;
+	pvt.heading = pos->heading;
+	/* The heading is the direction of the velocity, so its error grows as
+	 * the speed gets close to the speed error.
+	 */
+	pvt.heading_accuracy = atan2f(pvt.speed_accuracy, pos->speed) * 180.0f / (float)M_PI;
+	pvt.pdop = 1.6f;
+	pvt.hdop = 1.0f;
+	pvt.vdop = 1.3f;
+	pvt.tdop = 1.1f;
+	pvt.flags = NRF_MODEM_GNSS_PVT_FLAG_FIX_VALID;
+}
+
+static void event_send(int event)
+{
+	if (event_handler) {
+		event_handler(event);
+	}
+}
+
+/* Sleep until the next search of the periodic mode, or stop in single fix mode. */
+static void search_end(int event, int64_t now)
+{
+	event_send(event);
+
+	if (fix_interval == 0) {
+		running = false;
+		return;
+	}
+
+	k_work_reschedule(&replay_work,
+			  route_delay(search_start + fix_interval * MSEC_PER_SEC - now));
+	search_start = -1;
+}
+
+static void search_begin(int64_t now)
+{
+	search_start = now;
+	signal_since = -1;
+	tracking = false;
+}
+
+static void replay_work_fn(struct k_work *work)
+{
+	int64_t now = route_now();
+	int64_t ttff = (fixed_once ? CONFIG_GNSS_REPLAY_TTFF_HOT : CONFIG_GNSS_REPLAY_TTFF_COLD) *
+		       MSEC_PER_SEC;
+	struct row pos;
+	bool fix;
+
+	k_mutex_lock(&replay_lock, K_FOREVER);
+
+	if (!running) {
+		k_mutex_unlock(&replay_lock);
+		return;
+	}
+
+	if (search_start < 0) {
+		search_begin(now);
+		event_send(NRF_MODEM_GNSS_EVT_PERIODIC_WAKEUP);
+	}
+
+	fix = route_position(now, &pos);
+	if (!fix) {
+		/* No signal, acquire again once it is back. */
+		signal_since = -1;
+		tracking = false;
+	} else if (!tracking) {
+		if (signal_since < 0) {
+			signal_since = now;
+		}
+		tracking = (now - signal_since) >= ttff;
+		fix = tracking;
+	}
+
+	frame_fill(now, fix ? &pos : NULL);
+	event_send(NRF_MODEM_GNSS_EVT_PVT);
+
+	if (fix) {
+		fixed_once = true;
+		event_send(NRF_MODEM_GNSS_EVT_FIX);
+
+		if (fix_interval != 1) {
+			search_end(NRF_MODEM_GNSS_EVT_SLEEP_AFTER_FIX, now);
+		}
+	} else if ((fix_interval != 1) && (fix_retry > 0) &&
+		   ((now - search_start) >= fix_retry * MSEC_PER_SEC)) {
+		search_end(NRF_MODEM_GNSS_EVT_SLEEP_AFTER_TIMEOUT, now);
+	}
+
+	/* Once per second while searching, or tracking in continuous mode. */
+	if (running && (search_start >= 0)) {
+		k_work_reschedule(&replay_work, route_delay(MSEC_PER_SEC));
+	}
+
+	k_mutex_unlock(&replay_lock);
+}
+
+int32_t nrf_modem_gnss_event_handler_set(nrf_modem_gnss_event_handler_type_t handler)
+{
+	event_handler = handler;
+
+	return 0;
+}
+
+/* Configuration can only be changed while the GNSS is stopped. */
+static int32_t config_set(uint16_t *param, uint16_t value)
+{
+	int32_t err = 0;
+
+	k_mutex_lock(&replay_lock, K_FOREVER);
+	if (running) {
+		err = -EPERM;
+	} else if (param != NULL) {
+		*param = value;
+	}
+	k_mutex_unlock(&replay_lock);
+
+	return err;
+}
+
+int32_t nrf_modem_gnss_fix_interval_set(uint16_t interval)
+{
+	if ((interval > 1) && (interval < 10)) {
+		return -EINVAL;
+	}
+
+	return config_set(&fix_interval, interval);
+}
+
+int32_t nrf_modem_gnss_fix_retry_set(uint16_t retry)
+{
+	return config_set(&fix_retry, retry);
+}
+
+int32_t nrf_modem_gnss_use_case_set(uint8_t use_case)
+{
+	ARG_UNUSED(use_case);
+
+	return config_set(NULL, 0);
+}
+
+int32_t nrf_modem_gnss_timing_source_set(enum nrf_modem_gnss_timing_source timing_source)
+{
+	ARG_UNUSED(timing_source);
+
+	return config_set(NULL, 0);
+}
+
+/* Priority over LTE has no effect, nothing blocks the replay. */
+int32_t nrf_modem_gnss_prio_mode_enable(void)
+{
+	return running ? 0 : -EPERM;
+}
+
+int32_t nrf_modem_gnss_prio_mode_disable(void)
+{
+	return running ? 0 : -EPERM;
+}
+
+/* The route starts with the first start of the GNSS. */
+static int route_begin(void)
+{
+	if (uptime_start >= 0) {
+		return 0;
+	}
+
+	if (!row_next(&next)) {
+		LOG_ERR("The GNSS trace is empty");
+		return -ENODATA;
+	}
+
+	prev = next;
+	route_start = next.time * MSEC_PER_SEC;
+	uptime_start = k_uptime_get();
+
+	return 0;
+}
+
+int32_t nrf_modem_gnss_start(void)
+{
+	int32_t err;
+
+	k_mutex_lock(&replay_lock, K_FOREVER);
+
+	err = running ? -EPERM : route_begin();
+	if (err == 0) {
+		running = true;
+		search_begin(route_now());
+		k_work_reschedule(&replay_work, K_NO_WAIT);
+		LOG_DBG("Started, fix interval %u s, retry %u s", fix_interval, fix_retry);
+	}
+
+	k_mutex_unlock(&replay_lock);
+
+	return err;
+}
+
+int32_t nrf_modem_gnss_stop(void)
+{
+	int32_t err = 0;
+
+	k_mutex_lock(&replay_lock, K_FOREVER);
+
+	if (running) {
+		running = false;
+		(void)k_work_cancel_delayable(&replay_work);
+	} else {
+		err = -EPERM;
+	}
+
+	k_mutex_unlock(&replay_lock);
+
+	return err;
+}
+
+int32_t nrf_modem_gnss_read(void *buf, int32_t buf_len, int type)
+{
+	if (type != NRF_MODEM_GNSS_DATA_PVT) {
+		return -ENOMSG;
+	}
+
+	if ((buf == NULL) || (buf_len < (int32_t)sizeof(pvt))) {
+		return -EINVAL;
+	}
+
+	memcpy(buf, &pvt, sizeof(pvt));
+
+	return 0;
+}
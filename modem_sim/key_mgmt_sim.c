@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Credential storage of the simulated modem, behind the modem_key_mgmt API.
+ *
+ * The credentials are kept in RAM, so unlike on the modem they are lost when
+ * the application restarts. Like on the modem, they can only be changed
+ * while LTE is not active.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <modem/modem_key_mgmt.h>
+
+#include "modem_sim.h"
+
+LOG_MODULE_DECLARE(modem_sim, CONFIG_MODEM_SIM_LOG_LEVEL);
+
+struct key {
+	bool used;
+	nrf_sec_tag_t sec_tag;
+	enum modem_key_mgmt_cred_type cred_type;
+	size_t len;
+	uint8_t data[CONFIG_MODEM_SIM_KEY_MAX_LEN];
+};
+
+static struct key keys[CONFIG_MODEM_SIM_KEYS];
+static K_MUTEX_DEFINE(keys_lock);
+
+static struct key *key_find(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(keys); i++) {
+		if (keys[i].used && (keys[i].sec_tag == sec_tag) &&
+		    (keys[i].cred_type == cred_type)) {
+			return &keys[i];
+		}
+	}
+
+	return NULL;
+}
+
+bool key_sim_tag_exists(sec_tag_t tag)
+{
+	bool exists = false;
+
+	k_mutex_lock(&keys_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(keys); i++) {
+		if (keys[i].used && (keys[i].sec_tag == tag)) {
+			exists = true;
+			break;
+		}
+	}
+
+	k_mutex_unlock(&keys_lock);
+
+	return exists;
+}
+
+int modem_key_mgmt_write(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type,
+			 const void *buf, size_t len)
+{
+	struct key *key;
+	int err = 0;
+
+	if ((buf == NULL) || (len == 0) || (len > CONFIG_MODEM_SIM_KEY_MAX_LEN)) {
+		return -EINVAL;
+	}
+
+	if (lte_sim_active()) {
+		return -EACCES;
+	}
+
+	k_mutex_lock(&keys_lock, K_FOREVER);
+
+	key = key_find(sec_tag, cred_type);
+	for (size_t i = 0; (key == NULL) && (i < ARRAY_SIZE(keys)); i++) {
+		if (!keys[i].used) {
+			key = &keys[i];
+		}
+	}
+
+	if (key != NULL) {
+		key->used = true;
+		key->sec_tag = sec_tag;
+		key->cred_type = cred_type;
+		key->len = len;
+		memcpy(key->data, buf, len);
+		LOG_DBG("Credential %d written to sec tag %d", cred_type, sec_tag);
+	} else {
+		err = -ENOMEM;
+	}
+
+	k_mutex_unlock(&keys_lock);
+
+	return err;
+}
+
+int modem_key_mgmt_read(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type,
+			void *buf, size_t *len)
+{
+	struct key *key;
+	int err = 0;
+
+	k_mutex_lock(&keys_lock, K_FOREVER);
+
+	key = key_find(sec_tag, cred_type);
+	if (key == NULL) {
+		err = -ENOENT;
+	} else if (key->len > *len) {
+		err = -ENOMEM;
+	} else {
+		memcpy(buf, key->data, key->len);
+		*len = key->len;
+	}
+
+	k_mutex_unlock(&keys_lock);
+
+	return err;
+}
+
+int modem_key_mgmt_cmp(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type,
+		       const void *buf, size_t len)
+{
+	struct key *key;
+	int ret;
+
+	k_mutex_lock(&keys_lock, K_FOREVER);
+
+	key = key_find(sec_tag, cred_type);
+	if (key == NULL) {
+		ret = -ENOENT;
+	} else {
+		ret = ((key->len == len) && (memcmp(key->data, buf, len) == 0)) ? 0 : 1;
+	}
+
+	k_mutex_unlock(&keys_lock);
+
+	return ret;
+}
+
+int modem_key_mgmt_delete(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type)
+{
+	struct key *key;
+	int err = 0;
+
+	if (lte_sim_active()) {
+		return -EACCES;
+	}
+
+	k_mutex_lock(&keys_lock, K_FOREVER);
+
+	key = key_find(sec_tag, cred_type);
+	if (key == NULL) {
+		err = -ENOENT;
+	} else {
+		key->used = false;
+	}
+
+	k_mutex_unlock(&keys_lock);
+
+	return err;
+}
+
+int modem_key_mgmt_exists(nrf_sec_tag_t sec_tag, enum modem_key_mgmt_cred_type cred_type,
+			  bool *exists)
+{
+	k_mutex_lock(&keys_lock, K_FOREVER);
+	*exists = (key_find(sec_tag, cred_type) != NULL);
+	k_mutex_unlock(&keys_lock);
+
+	return 0;
+}
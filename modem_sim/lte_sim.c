@@ -0,0 +1,737 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Simulated LTE link behind the lte_lc API.
+ *
+ * The network is a set of timers: registration, RRC inactivity, release
+ * after release assistance, the PSM active time and the periodic TAU. The
+ * simulated sockets report their traffic, which sets up and keeps up the RRC
+ * connection. Events are sent to the handlers from the system work queue.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <modem/lte_lc.h>
+
+#include "modem_sim.h"
+
+LOG_MODULE_REGISTER(modem_sim, CONFIG_MODEM_SIM_LOG_LEVEL);
+
+#define HANDLERS_MAX 4
+/* Time to measure the neighbor cells. */
+#define NCELLMEAS_TIME_MS 1000
+
+#if defined(CONFIG_LTE_LC_TAU_PRE_WARNING_NOTIFICATIONS)
+#define TAU_PRE_WARNING_MS CONFIG_LTE_LC_TAU_PRE_WARNING_TIME_MS
+#else
+#define TAU_PRE_WARNING_MS 0
+#endif
+
+/* Units of the GPRS timer 3 (periodic TAU) and GPRS timer 2 (active time)
+ * bit strings, in seconds, see 3GPP TS 24.008. -1 marks a deactivated timer.
+ */
+static const int rptau_units[8] = { 600, 3600, 36000, 2, 30, 60, 1152000, -1 };
+static const int rat_units[8] = { 2, 60, 360, 60, 60, 60, 60, -1 };
+
+/* The API may be called from any thread, and from the event handlers. */
+static K_MUTEX_DEFINE(lte_lock);
+static lte_lc_evt_handler_t handlers[HANDLERS_MAX];
+
+static enum lte_lc_func_mode func_mode = LTE_LC_FUNC_MODE_POWER_OFF;
+static enum lte_lc_system_mode system_mode = LTE_LC_SYSTEM_MODE_LTEM_NBIOT_GPS;
+static enum lte_lc_system_mode_preference system_mode_pref = LTE_LC_SYSTEM_MODE_PREFER_AUTO;
+static bool lte_on;
+static uint32_t power_cycles;
+
+static enum lte_lc_nw_reg_status reg_status = LTE_LC_NW_REG_NOT_REGISTERED;
+static enum lte_lc_lte_mode lte_mode = LTE_LC_LTE_MODE_NONE;
+static bool rrc_connected;
+/* In PSM, until the next TAU or uplink data. */
+static bool sleeping;
+
+static bool psm_requested;
+static bool edrx_requested = IS_ENABLED(CONFIG_LTE_EDRX_REQ);
+static const char *psm_rptau = CONFIG_LTE_PSM_REQ_RPTAU;
+static const char *psm_rat = CONFIG_LTE_PSM_REQ_RAT;
+static char rptau_buf[9];
+static char rat_buf[9];
+/* Granted PSM timers (s), -1 if PSM is not granted. */
+static int psm_tau = -1;
+static int psm_active_time = -1;
+/* Uptime (ms) of the next periodic TAU. */
+static int64_t tau_at;
+static bool tau_prewarned;
+
+static bool ncellmeas_active;
+
+static void reg_work_fn(struct k_work *work);
+static void release_work_fn(struct k_work *work);
+static void sleep_work_fn(struct k_work *work);
+static void tau_work_fn(struct k_work *work);
+static void ncellmeas_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(reg_work, reg_work_fn);
+static K_WORK_DELAYABLE_DEFINE(release_work, release_work_fn);
+static K_WORK_DELAYABLE_DEFINE(sleep_work, sleep_work_fn);
+static K_WORK_DELAYABLE_DEFINE(tau_work, tau_work_fn);
+static K_WORK_DELAYABLE_DEFINE(ncellmeas_work, ncellmeas_work_fn);
+
+static void evt_send(const struct lte_lc_evt *evt)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(handlers); i++) {
+		if (handlers[i] != NULL) {
+			handlers[i](evt);
+		}
+	}
+}
+
+static bool registered(void)
+{
+	return (reg_status == LTE_LC_NW_REG_REGISTERED_HOME) ||
+	       (reg_status == LTE_LC_NW_REG_REGISTERED_ROAMING);
+}
+
+static void reg_status_set(enum lte_lc_nw_reg_status status)
+{
+	if (reg_status == status) {
+		return;
+	}
+
+	reg_status = status;
+	evt_send(&(struct lte_lc_evt){
+		.type = LTE_LC_EVT_NW_REG_STATUS,
+		.nw_reg_status = status,
+	});
+}
+
+static void lte_mode_set(enum lte_lc_lte_mode mode)
+{
+	if (lte_mode == mode) {
+		return;
+	}
+
+	lte_mode = mode;
+	evt_send(&(struct lte_lc_evt){
+		.type = LTE_LC_EVT_LTE_MODE_UPDATE,
+		.lte_mode = mode,
+	});
+}
+
+static void rrc_set(bool connected)
+{
+	if (rrc_connected == connected) {
+		return;
+	}
+
+	rrc_connected = connected;
+	LOG_DBG("RRC %s", connected ? "connected" : "idle");
+	evt_send(&(struct lte_lc_evt){
+		.type = LTE_LC_EVT_RRC_UPDATE,
+		.rrc_mode = connected ? LTE_LC_RRC_MODE_CONNECTED : LTE_LC_RRC_MODE_IDLE,
+	});
+}
+
+/* LTE mode the modem registers on, none if LTE is not enabled. */
+static enum lte_lc_lte_mode mode_select(void)
+{
+	switch (system_mode) {
+	case LTE_LC_SYSTEM_MODE_LTEM:
+	case LTE_LC_SYSTEM_MODE_LTEM_GPS:
+		return LTE_LC_LTE_MODE_LTEM;
+	case LTE_LC_SYSTEM_MODE_NBIOT:
+	case LTE_LC_SYSTEM_MODE_NBIOT_GPS:
+		return LTE_LC_LTE_MODE_NBIOT;
+	case LTE_LC_SYSTEM_MODE_LTEM_NBIOT:
+	case LTE_LC_SYSTEM_MODE_LTEM_NBIOT_GPS:
+		return ((system_mode_pref == LTE_LC_SYSTEM_MODE_PREFER_NBIOT) ||
+			(system_mode_pref == LTE_LC_SYSTEM_MODE_PREFER_NBIOT_PLMN_PRIO)) ?
+			LTE_LC_LTE_MODE_NBIOT : LTE_LC_LTE_MODE_LTEM;
+	default:
+		return LTE_LC_LTE_MODE_NONE;
+	}
+}
+
+/* Decode a GPRS timer bit string, 3 bits of unit and 5 bits of value.
+ * Returns the time in seconds, -1 if the timer is deactivated or invalid.
+ */
+static int timer_decode(const char *bits, const int units[8])
+{
+	char *end;
+	long value;
+
+	if (strlen(bits) != 8) {
+		return -1;
+	}
+
+	value = strtol(bits, &end, 2);
+	if ((*end != '\0') || (value < 0) || (units[value >> 5] < 0)) {
+		return -1;
+	}
+
+	return units[value >> 5] * (value & 0x1f);
+}
+
+static void psm_update(void)
+{
+	psm_tau = -1;
+	psm_active_time = -1;
+
+	if (psm_requested && IS_ENABLED(CONFIG_MODEM_SIM_PSM)) {
+		int tau = timer_decode(psm_rptau, rptau_units);
+		int active_time = timer_decode(psm_rat, rat_units);
+
+		if ((tau > 0) && (active_time >= 0)) {
+			psm_tau = tau;
+			psm_active_time = active_time;
+		} else {
+			LOG_WRN("Invalid PSM timers requested, PSM not granted");
+		}
+	}
+
+	evt_send(&(struct lte_lc_evt){
+		.type = LTE_LC_EVT_PSM_UPDATE,
+		.psm_cfg = {
+			.tau = psm_tau,
+			.active_time = psm_active_time,
+		},
+	});
+}
+
+static void edrx_update(void)
+{
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_EDRX_UPDATE,
+		.edrx_cfg.mode = lte_mode,
+	};
+
+#if defined(CONFIG_MODEM_SIM_EDRX)
+	if (edrx_requested) {
+		evt.edrx_cfg.edrx = CONFIG_MODEM_SIM_EDRX_CYCLE_MS / 1000.0f;
+		evt.edrx_cfg.ptw = CONFIG_MODEM_SIM_EDRX_PTW_MS / 1000.0f;
+	}
+#endif
+
+	evt_send(&evt);
+}
+
+static void wake(void)
+{
+	if (!sleeping) {
+		return;
+	}
+
+	sleeping = false;
+#if defined(CONFIG_LTE_LC_MODEM_SLEEP_NOTIFICATIONS)
+	evt_send(&(struct lte_lc_evt){
+		.type = LTE_LC_EVT_MODEM_SLEEP_EXIT,
+		.modem_sleep.type = LTE_LC_MODEM_SLEEP_PSM,
+	});
+#endif
+}
+
+static void rrc_connect(void)
+{
+	(void)k_work_cancel_delayable(&sleep_work);
+	(void)k_work_cancel_delayable(&tau_work);
+	wake();
+	rrc_set(true);
+}
+
+/* Start the PSM timers at the RRC release. */
+static void idle_begin(void)
+{
+	int64_t tau_ms;
+
+	if (psm_tau < 0) {
+		return;
+	}
+
+	tau_ms = (int64_t)psm_tau * MSEC_PER_SEC;
+	tau_at = k_uptime_get() + tau_ms;
+	tau_prewarned = (TAU_PRE_WARNING_MS == 0);
+
+	k_work_reschedule(&sleep_work, K_SECONDS(psm_active_time));
+	k_work_reschedule(&tau_work, K_MSEC(MAX(tau_ms - TAU_PRE_WARNING_MS, 0)));
+}
+
+/* A parameter change, which the modem signals to the network with a TAU. */
+static void tau_update(void)
+{
+	if (!rrc_connected) {
+		rrc_connect();
+		k_work_reschedule(&release_work, K_MSEC(CONFIG_MODEM_SIM_RAI_RELEASE_TIME_MS));
+	}
+}
+
+static int rrc_setup_time_ms(void)
+{
+	return (lte_mode == LTE_LC_LTE_MODE_NBIOT) ? CONFIG_MODEM_SIM_NBIOT_RRC_SETUP_TIME_MS :
+						     CONFIG_MODEM_SIM_LTE_M_RRC_SETUP_TIME_MS;
+}
+
+static void lte_start(void)
+{
+	if (lte_on) {
+		return;
+	}
+
+	lte_on = true;
+	if (mode_select() == LTE_LC_LTE_MODE_NONE) {
+		/* GNSS only. */
+		return;
+	}
+
+	reg_status_set(LTE_LC_NW_REG_SEARCHING);
+	k_work_reschedule(&reg_work, K_MSEC(CONFIG_MODEM_SIM_REGISTRATION_TIME_MS));
+}
+
+static void lte_stop(void)
+{
+	if (!lte_on) {
+		return;
+	}
+
+	lte_on = false;
+	(void)k_work_cancel_delayable(&reg_work);
+	(void)k_work_cancel_delayable(&release_work);
+	(void)k_work_cancel_delayable(&sleep_work);
+	(void)k_work_cancel_delayable(&tau_work);
+
+	sleeping = false;
+	rrc_set(false);
+	reg_status_set(LTE_LC_NW_REG_NOT_REGISTERED);
+	lte_mode_set(LTE_LC_LTE_MODE_NONE);
+}
+
+static void reg_work_fn(struct k_work *work)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (lte_on && !registered()) {
+		rrc_set(true);
+		lte_mode_set(mode_select());
+		evt_send(&(struct lte_lc_evt){
+			.type = LTE_LC_EVT_CELL_UPDATE,
+			.cell = {
+				.id = CONFIG_MODEM_SIM_CELL_ID,
+				.tac = CONFIG_MODEM_SIM_TAC,
+			},
+		});
+		reg_status_set(LTE_LC_NW_REG_REGISTERED_HOME);
+		LOG_INF("Registered on %s", (lte_mode == LTE_LC_LTE_MODE_NBIOT) ? "NB-IoT" : "LTE-M");
+
+		psm_update();
+		if (edrx_requested) {
+			edrx_update();
+		}
+
+		k_work_reschedule(&release_work, K_MSEC(CONFIG_MODEM_SIM_RRC_INACTIVITY_TIME_MS));
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+static void release_work_fn(struct k_work *work)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (rrc_connected) {
+		rrc_set(false);
+		idle_begin();
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+static void sleep_work_fn(struct k_work *work)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (registered() && !rrc_connected && (psm_tau > 0) && !sleeping) {
+		sleeping = true;
+#if defined(CONFIG_LTE_LC_MODEM_SLEEP_NOTIFICATIONS)
+		evt_send(&(struct lte_lc_evt){
+			.type = LTE_LC_EVT_MODEM_SLEEP_ENTER,
+			.modem_sleep = {
+				.type = LTE_LC_MODEM_SLEEP_PSM,
+				.time = MAX(tau_at - k_uptime_get(), 0),
+			},
+		});
+#endif
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+static void tau_work_fn(struct k_work *work)
+{
+	int64_t left;
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (registered() && !rrc_connected && (psm_tau > 0)) {
+		left = MAX(tau_at - k_uptime_get(), 0);
+
+		if (!tau_prewarned) {
+			tau_prewarned = true;
+			evt_send(&(struct lte_lc_evt){
+				.type = LTE_LC_EVT_TAU_PRE_WARNING,
+				.time = left,
+			});
+			k_work_reschedule(&tau_work, K_MSEC(left));
+		} else {
+			LOG_DBG("Periodic TAU");
+			rrc_connect();
+			k_work_reschedule(&release_work,
+					  K_MSEC(CONFIG_MODEM_SIM_RAI_RELEASE_TIME_MS));
+		}
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+static void ncellmeas_work_fn(struct k_work *work)
+{
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_NEIGHBOR_CELL_MEAS,
+	};
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (ncellmeas_active) {
+		ncellmeas_active = false;
+		evt.cells_info.current_cell = (struct lte_lc_cell){
+			.mcc = CONFIG_MODEM_SIM_MCC,
+			.mnc = CONFIG_MODEM_SIM_MNC,
+			.id = registered() ? CONFIG_MODEM_SIM_CELL_ID : LTE_LC_CELL_EUTRAN_ID_INVALID,
+			.tac = CONFIG_MODEM_SIM_TAC,
+			.earfcn = CONFIG_MODEM_SIM_EARFCN,
+			.rsrp = CONFIG_MODEM_SIM_RSRP,
+			.measurement_time = k_uptime_get(),
+		};
+		evt_send(&evt);
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+bool lte_sim_registered(void)
+{
+	return registered();
+}
+
+bool lte_sim_active(void)
+{
+	return lte_on;
+}
+
+uint32_t lte_sim_power_cycles(void)
+{
+	return power_cycles;
+}
+
+void lte_sim_uplink(void)
+{
+	int setup_ms = 0;
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (registered()) {
+		if (!rrc_connected) {
+			rrc_connect();
+			setup_ms = rrc_setup_time_ms();
+		}
+		k_work_reschedule(&release_work, K_MSEC(CONFIG_MODEM_SIM_RRC_INACTIVITY_TIME_MS));
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	if (setup_ms > 0) {
+		k_sleep(K_MSEC(setup_ms));
+	}
+}
+
+void lte_sim_downlink(void)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (registered()) {
+		rrc_connect();
+		k_work_reschedule(&release_work, K_MSEC(CONFIG_MODEM_SIM_RRC_INACTIVITY_TIME_MS));
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+void lte_sim_release(void)
+{
+	if (!IS_ENABLED(CONFIG_LTE_RAI_REQ)) {
+		return;
+	}
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (rrc_connected) {
+		k_work_reschedule(&release_work, K_MSEC(CONFIG_MODEM_SIM_RAI_RELEASE_TIME_MS));
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+int lte_lc_init(void)
+{
+	return 0;
+}
+
+void lte_lc_register_handler(lte_lc_evt_handler_t handler)
+{
+	size_t free = ARRAY_SIZE(handlers);
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(handlers); i++) {
+		if (handlers[i] == handler) {
+			free = i;
+			break;
+		}
+		if ((handlers[i] == NULL) && (free == ARRAY_SIZE(handlers))) {
+			free = i;
+		}
+	}
+
+	if (free < ARRAY_SIZE(handlers)) {
+		handlers[free] = handler;
+	} else {
+		LOG_ERR("Too many LTE event handlers");
+	}
+
+	k_mutex_unlock(&lte_lock);
+}
+
+int lte_lc_deregister_handler(lte_lc_evt_handler_t handler)
+{
+	int err = -ENXIO;
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(handlers); i++) {
+		if (handlers[i] == handler) {
+			handlers[i] = NULL;
+			err = 0;
+		}
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return err;
+}
+
+int lte_lc_connect_async(lte_lc_evt_handler_t handler)
+{
+	if (handler != NULL) {
+		lte_lc_register_handler(handler);
+	}
+
+	return lte_lc_func_mode_set(LTE_LC_FUNC_MODE_NORMAL);
+}
+
+int lte_lc_init_and_connect_async(lte_lc_evt_handler_t handler)
+{
+	return lte_lc_connect_async(handler);
+}
+
+int lte_lc_func_mode_set(enum lte_lc_func_mode mode)
+{
+	int err = 0;
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	switch (mode) {
+	case LTE_LC_FUNC_MODE_NORMAL:
+	case LTE_LC_FUNC_MODE_ACTIVATE_LTE:
+		lte_start();
+		break;
+	case LTE_LC_FUNC_MODE_POWER_OFF:
+		lte_stop();
+		power_cycles++;
+		break;
+	case LTE_LC_FUNC_MODE_OFFLINE:
+	case LTE_LC_FUNC_MODE_DEACTIVATE_LTE:
+		lte_stop();
+		break;
+	case LTE_LC_FUNC_MODE_ACTIVATE_GNSS:
+	case LTE_LC_FUNC_MODE_DEACTIVATE_GNSS:
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	if (err == 0) {
+		func_mode = mode;
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return err;
+}
+
+int lte_lc_func_mode_get(enum lte_lc_func_mode *mode)
+{
+	*mode = func_mode;
+
+	return 0;
+}
+
+int lte_lc_normal(void)
+{
+	return lte_lc_func_mode_set(LTE_LC_FUNC_MODE_NORMAL);
+}
+
+int lte_lc_offline(void)
+{
+	return lte_lc_func_mode_set(LTE_LC_FUNC_MODE_OFFLINE);
+}
+
+int lte_lc_power_off(void)
+{
+	return lte_lc_func_mode_set(LTE_LC_FUNC_MODE_POWER_OFF);
+}
+
+int lte_lc_psm_param_set(const char *rptau, const char *rat)
+{
+	if (rptau == NULL) {
+		rptau = CONFIG_LTE_PSM_REQ_RPTAU;
+	}
+	if (rat == NULL) {
+		rat = CONFIG_LTE_PSM_REQ_RAT;
+	}
+
+	if ((strlen(rptau) != 8) || (strlen(rat) != 8)) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+	strcpy(rptau_buf, rptau);
+	strcpy(rat_buf, rat);
+	psm_rptau = rptau_buf;
+	psm_rat = rat_buf;
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_psm_req(bool enable)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	psm_requested = enable;
+	if (registered()) {
+		tau_update();
+		psm_update();
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_psm_get(int *tau, int *active_time)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+	*tau = psm_tau;
+	*active_time = psm_active_time;
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_edrx_req(bool enable)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	edrx_requested = enable;
+	if (registered()) {
+		tau_update();
+		edrx_update();
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_system_mode_set(enum lte_lc_system_mode mode,
+			   enum lte_lc_system_mode_preference preference)
+{
+	bool was_on;
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	/* The modem goes offline for the change, like with the link controller. */
+	was_on = lte_on;
+	lte_stop();
+	system_mode = mode;
+	system_mode_pref = preference;
+	if (was_on) {
+		lte_start();
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_system_mode_get(enum lte_lc_system_mode *mode,
+			   enum lte_lc_system_mode_preference *preference)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+	*mode = system_mode;
+	if (preference != NULL) {
+		*preference = system_mode_pref;
+	}
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
+
+int lte_lc_lte_mode_get(enum lte_lc_lte_mode *mode)
+{
+	*mode = lte_mode;
+
+	return 0;
+}
+
+int lte_lc_neighbor_cell_measurement(enum lte_lc_neighbor_search_type type)
+{
+	int err = 0;
+
+	ARG_UNUSED(type);
+
+	k_mutex_lock(&lte_lock, K_FOREVER);
+
+	if (ncellmeas_active) {
+		err = -EINPROGRESS;
+	} else {
+		ncellmeas_active = true;
+		k_work_reschedule(&ncellmeas_work, K_MSEC(NCELLMEAS_TIME_MS));
+	}
+
+	k_mutex_unlock(&lte_lock);
+
+	return err;
+}
+
+int lte_lc_neighbor_cell_measurement_cancel(void)
+{
+	k_mutex_lock(&lte_lock, K_FOREVER);
+	ncellmeas_active = false;
+	(void)k_work_cancel_delayable(&ncellmeas_work);
+	k_mutex_unlock(&lte_lock);
+
+	return 0;
+}
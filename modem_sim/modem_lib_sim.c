@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Modem library calls of the simulated modem. Only the AT commands the
+ * course samples send are answered.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <modem/lte_lc.h>
+#include <modem/nrf_modem_lib.h>
+#include <nrf_modem_at.h>
+
+LOG_MODULE_DECLARE(modem_sim, CONFIG_MODEM_SIM_LOG_LEVEL);
+
+int nrf_modem_lib_init(void)
+{
+	LOG_INF("Simulated modem, IMEI %s", CONFIG_MODEM_SIM_IMEI);
+
+	return 0;
+}
+
+int nrf_modem_lib_shutdown(void)
+{
+	return lte_lc_power_off();
+}
+
+int nrf_modem_at_cmd(void *buf, size_t len, const char *fmt, ...)
+{
+	char cmd[64];
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsnprintf(cmd, sizeof(cmd), fmt, args);
+	va_end(args);
+
+	if ((ret < 0) || (ret >= sizeof(cmd))) {
+		return -E2BIG;
+	}
+
+	if (strcmp(cmd, "AT+CGSN") == 0) {
+		ret = snprintf(buf, len, "%s\r\nOK\r\n", CONFIG_MODEM_SIM_IMEI);
+		return ((ret < 0) || (ret >= len)) ? -E2BIG : 0;
+	}
+
+	LOG_WRN("AT command not simulated: %s", cmd);
+
+	return NRF_MODEM_AT_ERROR << 16;
+}
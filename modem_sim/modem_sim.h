@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef _MODEM_SIM_H_
+#define _MODEM_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/net/tls_credentials.h>
+
+/* Interface between the parts of the simulated modem. */
+
+/* Whether the modem is registered to the network. */
+bool lte_sim_registered(void);
+
+/* Whether LTE is active, registered or not. */
+bool lte_sim_active(void);
+
+/* Counts the times the modem was turned off, which drops the TLS sessions. */
+uint32_t lte_sim_power_cycles(void);
+
+/* Called before a packet is sent. Wakes the modem from PSM and sets up the
+ * RRC connection if needed, which blocks for the setup time.
+ */
+void lte_sim_uplink(void);
+
+/* Called after a packet is received. */
+void lte_sim_downlink(void);
+
+/* Release assistance, the RRC connection is released shortly. */
+void lte_sim_release(void);
+
+/* Whether a credential of any type is stored in @p tag. */
+bool key_sim_tag_exists(sec_tag_t tag);
+
+#endif /* _MODEM_SIM_H_ */
@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Offloaded sockets of the simulated modem.
+ *
+ * Every socket is passed to a host socket, created by the native_sim
+ * offloaded sockets below this one. Each packet is reported to the
+ * simulated LTE link, which sets up the RRC connection and restarts the
+ * inactivity timer, and the release assistance options release it.
+ *
+ * TLS and DTLS are not run. A secure socket is a plain TCP or UDP socket,
+ * its connect() takes the time of a full or resumed handshake, and the
+ * modem session cache is modeled for the TLS_SESSION_CACHE options.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/fdtable.h>
+
+#include "sockets_internal.h"
+#include "modem_sim.h"
+
+LOG_MODULE_DECLARE(modem_sim, CONFIG_MODEM_SIM_LOG_LEVEL);
+
+/* As many as the modem. */
+#define SOCKETS_MAX 8
+#define SEC_TAGS_MAX 7
+
+enum rai_action {
+	RAI_ACTION_NONE,
+	/* Release now. */
+	RAI_ACTION_NOW,
+	/* Release after the next packet is sent. */
+	RAI_ACTION_AFTER_SEND,
+	/* Release after the next packet is received. */
+	RAI_ACTION_AFTER_RECV,
+};
+
+struct sim_socket {
+	bool used;
+	int inner;
+	bool stream;
+	bool secure;
+	enum rai_action rai;
+	/* Secure sockets. */
+	sec_tag_t sec_tags[SEC_TAGS_MAX];
+	uint8_t sec_tag_count;
+	bool session_cache;
+	bool resumed;
+};
+
+/* The modem caches one TLS session, with the last server. */
+static struct {
+	bool valid;
+	struct sockaddr peer;
+	socklen_t peer_len;
+	uint32_t power_cycles;
+} session;
+
+static struct sim_socket sockets[SOCKETS_MAX];
+static K_MUTEX_DEFINE(sockets_lock);
+/* Thread creating a host socket, which is not simulated. */
+static k_tid_t creating;
+
+static const struct socket_op_vtable sim_socket_vtable;
+
+/* The secure protocols are numbered from IPPROTO_TLS_1_0 on. */
+static bool proto_secure(int proto)
+{
+	return proto >= IPPROTO_TLS_1_0;
+}
+
+/* Release assistance set by @p optname, -1 if it is another option. */
+static int rai_action_get(int optname, const void *optval, socklen_t optlen)
+{
+#if defined(SO_RAI)
+	if ((optname != SO_RAI) || (optval == NULL) || (optlen != sizeof(int))) {
+		return -1;
+	}
+
+	switch (*(const int *)optval) {
+	case RAI_NO_DATA:
+		return RAI_ACTION_NOW;
+	case RAI_LAST:
+		return RAI_ACTION_AFTER_SEND;
+	case RAI_ONE_RESP:
+		return RAI_ACTION_AFTER_RECV;
+	default:
+		return RAI_ACTION_NONE;
+	}
+#else
+	switch (optname) {
+	case SO_RAI_NO_DATA:
+		return RAI_ACTION_NOW;
+	case SO_RAI_LAST:
+		return RAI_ACTION_AFTER_SEND;
+	case SO_RAI_ONE_RESP:
+		return RAI_ACTION_AFTER_RECV;
+	case SO_RAI_ONGOING:
+	case SO_RAI_WAIT_MORE:
+		return RAI_ACTION_NONE;
+	default:
+		return -1;
+	}
+#endif
+}
+
+static bool credentials_exist(const struct sim_socket *s)
+{
+	for (size_t i = 0; i < s->sec_tag_count; i++) {
+		if (key_sim_tag_exists(s->sec_tags[i])) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int handshake(struct sim_socket *s, const struct sockaddr *addr, socklen_t addrlen)
+{
+	if (!credentials_exist(s)) {
+		LOG_WRN("No credentials in the sec tags of the socket");
+		errno = ECONNREFUSED;
+		return -1;
+	}
+
+	s->resumed = s->session_cache && session.valid &&
+		     (session.power_cycles == lte_sim_power_cycles()) &&
+		     (session.peer_len == addrlen) && (memcmp(&session.peer, addr, addrlen) == 0);
+
+	lte_sim_uplink();
+	k_sleep(K_MSEC(s->resumed ? CONFIG_MODEM_SIM_DTLS_RESUME_TIME_MS :
+				    CONFIG_MODEM_SIM_DTLS_HANDSHAKE_TIME_MS));
+	lte_sim_downlink();
+
+	if (s->session_cache && (addrlen <= sizeof(session.peer))) {
+		memcpy(&session.peer, addr, addrlen);
+		session.peer_len = addrlen;
+		session.power_cycles = lte_sim_power_cycles();
+		session.valid = true;
+	}
+
+	return 0;
+}
+
+static void sent(struct sim_socket *s)
+{
+	if (s->rai == RAI_ACTION_AFTER_SEND) {
+		s->rai = RAI_ACTION_NONE;
+		lte_sim_release();
+	}
+}
+
+static void received(struct sim_socket *s)
+{
+	lte_sim_downlink();
+
+	if (s->rai == RAI_ACTION_AFTER_RECV) {
+		s->rai = RAI_ACTION_NONE;
+		lte_sim_release();
+	}
+}
+
+static int tls_setsockopt(struct sim_socket *s, int optname, const void *optval,
+			  socklen_t optlen)
+{
+	if (!s->secure) {
+		errno = ENOPROTOOPT;
+		return -1;
+	}
+
+	switch (optname) {
+	case TLS_SEC_TAG_LIST:
+		if ((optval == NULL) || (optlen % sizeof(sec_tag_t) != 0) ||
+		    (optlen / sizeof(sec_tag_t) > ARRAY_SIZE(s->sec_tags))) {
+			errno = EINVAL;
+			return -1;
+		}
+		memcpy(s->sec_tags, optval, optlen);
+		s->sec_tag_count = optlen / sizeof(sec_tag_t);
+		return 0;
+	case TLS_SESSION_CACHE:
+		if ((optval == NULL) || (optlen != sizeof(int))) {
+			errno = EINVAL;
+			return -1;
+		}
+		s->session_cache = (*(const int *)optval == TLS_SESSION_CACHE_ENABLED);
+		return 0;
+	case TLS_SESSION_CACHE_PURGE:
+		session.valid = false;
+		return 0;
+	default:
+		/* Peer verification, host name and the like have no effect. */
+		return 0;
+	}
+}
+
+static int tls_getsockopt(struct sim_socket *s, int optname, void *optval, socklen_t *optlen)
+{
+	int value;
+
+	if (!s->secure) {
+		errno = ENOPROTOOPT;
+		return -1;
+	}
+
+	switch (optname) {
+	case TLS_SESSION_CACHE:
+		value = s->session_cache ? TLS_SESSION_CACHE_ENABLED : TLS_SESSION_CACHE_DISABLED;
+		break;
+#if defined(TLS_DTLS_HANDSHAKE_STATUS)
+	case TLS_DTLS_HANDSHAKE_STATUS:
+		value = s->resumed ? TLS_DTLS_HANDSHAKE_STATUS_CACHED :
+				     TLS_DTLS_HANDSHAKE_STATUS_FULL;
+		break;
+#endif
+	default:
+		errno = ENOPROTOOPT;
+		return -1;
+	}
+
+	if ((optval == NULL) || (optlen == NULL) || (*optlen < sizeof(value))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	memcpy(optval, &value, sizeof(value));
+	*optlen = sizeof(value);
+
+	return 0;
+}
+
+/* Poll the host sockets of the simulated ones, and any other descriptor. */
+static int sim_poll(struct zsock_pollfd *fds, int nfds, int timeout)
+{
+	struct zsock_pollfd inner[CONFIG_NET_SOCKETS_POLL_MAX];
+	struct sim_socket *s;
+	int ret;
+
+	if (nfds > ARRAY_SIZE(inner)) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (int i = 0; i < nfds; i++) {
+		inner[i] = fds[i];
+		s = z_get_fd_obj(fds[i].fd, (const struct fd_op_vtable *)&sim_socket_vtable, 0);
+		if (s != NULL) {
+			inner[i].fd = s->inner;
+		}
+	}
+
+	ret = zsock_poll(inner, nfds, timeout);
+
+	for (int i = 0; i < nfds; i++) {
+		fds[i].revents = inner[i].revents;
+	}
+
+	return ret;
+}
+
+static ssize_t sim_sendto(void *obj, const void *buf, size_t len, int flags,
+			  const struct sockaddr *to, socklen_t tolen)
+{
+	struct sim_socket *s = obj;
+	ssize_t ret;
+
+	if (!lte_sim_registered()) {
+		errno = ENETUNREACH;
+		return -1;
+	}
+
+	lte_sim_uplink();
+
+	ret = zsock_sendto(s->inner, buf, len, flags, to, tolen);
+	if (ret >= 0) {
+		sent(s);
+	}
+
+	return ret;
+}
+
+static ssize_t sim_sendmsg(void *obj, const struct msghdr *msg, int flags)
+{
+	struct sim_socket *s = obj;
+	ssize_t ret;
+
+	if (!lte_sim_registered()) {
+		errno = ENETUNREACH;
+		return -1;
+	}
+
+	lte_sim_uplink();
+
+	ret = zsock_sendmsg(s->inner, msg, flags);
+	if (ret >= 0) {
+		sent(s);
+	}
+
+	return ret;
+}
+
+static ssize_t sim_recvfrom(void *obj, void *buf, size_t max_len, int flags,
+			    struct sockaddr *from, socklen_t *fromlen)
+{
+	struct sim_socket *s = obj;
+	ssize_t ret;
+
+	ret = zsock_recvfrom(s->inner, buf, max_len, flags, from, fromlen);
+	if ((ret > 0) && !(flags & ZSOCK_MSG_PEEK)) {
+		received(s);
+	}
+
+	return ret;
+}
+
+static ssize_t sim_read(void *obj, void *buf, size_t len)
+{
+	return sim_recvfrom(obj, buf, len, 0, NULL, NULL);
+}
+
+static ssize_t sim_write(void *obj, const void *buf, size_t len)
+{
+	return sim_sendto(obj, buf, len, 0, NULL, 0);
+}
+
+static int sim_connect(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct sim_socket *s = obj;
+
+	if (!lte_sim_registered()) {
+		errno = ENETUNREACH;
+		return -1;
+	}
+
+	if (s->stream) {
+		lte_sim_uplink();
+	}
+
+	if (zsock_connect(s->inner, addr, addrlen) < 0) {
+		return -1;
+	}
+
+	return s->secure ? handshake(s, addr, addrlen) : 0;
+}
+
+static int sim_bind(void *obj, const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct sim_socket *s = obj;
+
+	return zsock_bind(s->inner, addr, addrlen);
+}
+
+static int sim_shutdown(void *obj, int how)
+{
+	struct sim_socket *s = obj;
+
+	return zsock_shutdown(s->inner, how);
+}
+
+static int sim_getsockname(void *obj, struct sockaddr *addr, socklen_t *addrlen)
+{
+	struct sim_socket *s = obj;
+
+	return zsock_getsockname(s->inner, addr, addrlen);
+}
+
+static int sim_setsockopt(void *obj, int level, int optname, const void *optval,
+			  socklen_t optlen)
+{
+	struct sim_socket *s = obj;
+	int rai;
+
+	if (level == SOL_TLS) {
+		return tls_setsockopt(s, optname, optval, optlen);
+	}
+
+	if (level == SOL_SOCKET) {
+		rai = rai_action_get(optname, optval, optlen);
+		if (rai == RAI_ACTION_NOW) {
+			s->rai = RAI_ACTION_NONE;
+			lte_sim_release();
+			return 0;
+		} else if (rai >= 0) {
+			s->rai = rai;
+			return 0;
+		}
+	}
+
+	return zsock_setsockopt(s->inner, level, optname, optval, optlen);
+}
+
+static int sim_getsockopt(void *obj, int level, int optname, void *optval, socklen_t *optlen)
+{
+	struct sim_socket *s = obj;
+
+	if (level == SOL_TLS) {
+		return tls_getsockopt(s, optname, optval, optlen);
+	}
+
+	return zsock_getsockopt(s->inner, level, optname, optval, optlen);
+}
+
+static int sim_close(void *obj)
+{
+	struct sim_socket *s = obj;
+	int ret;
+
+	ret = zsock_close(s->inner);
+
+	k_mutex_lock(&sockets_lock, K_FOREVER);
+	s->used = false;
+	k_mutex_unlock(&sockets_lock);
+
+	return ret;
+}
+
+static int sim_ioctl(void *obj, unsigned int request, va_list args)
+{
+	struct sim_socket *s = obj;
+
+	switch (request) {
+	case ZFD_IOCTL_POLL_PREPARE:
+		/* The whole poll() is passed to sim_poll(). */
+		return -EXDEV;
+	case ZFD_IOCTL_POLL_UPDATE:
+		return -EOPNOTSUPP;
+	case ZFD_IOCTL_POLL_OFFLOAD: {
+		struct zsock_pollfd *fds = va_arg(args, struct zsock_pollfd *);
+		int nfds = va_arg(args, int);
+		int timeout = va_arg(args, int);
+
+		return sim_poll(fds, nfds, timeout);
+	}
+	case F_GETFL:
+		return zsock_fcntl(s->inner, F_GETFL, 0);
+	case F_SETFL:
+		return zsock_fcntl(s->inner, F_SETFL, va_arg(args, int));
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+static const struct socket_op_vtable sim_socket_vtable = {
+	.fd_vtable = {
+		.read = sim_read,
+		.write = sim_write,
+		.close = sim_close,
+		.ioctl = sim_ioctl,
+	},
+	.shutdown = sim_shutdown,
+	.bind = sim_bind,
+	.connect = sim_connect,
+	.sendto = sim_sendto,
+	.sendmsg = sim_sendmsg,
+	.recvfrom = sim_recvfrom,
+	.getsockopt = sim_getsockopt,
+	.setsockopt = sim_setsockopt,
+	.getsockname = sim_getsockname,
+};
+
+static bool sim_socket_is_supported(int family, int type, int proto)
+{
+	if (creating == k_current_get()) {
+		return false;
+	}
+
+	return ((family == AF_INET) || (family == AF_INET6)) &&
+	       ((type == SOCK_STREAM) || (type == SOCK_DGRAM));
+}
+
+static int sim_socket_create(int family, int type, int proto)
+{
+	struct sim_socket *s = NULL;
+	int fd;
+
+	k_mutex_lock(&sockets_lock, K_FOREVER);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sockets); i++) {
+		if (!sockets[i].used) {
+			s = &sockets[i];
+			break;
+		}
+	}
+
+	if (s == NULL) {
+		k_mutex_unlock(&sockets_lock);
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	fd = z_reserve_fd();
+	if (fd < 0) {
+		k_mutex_unlock(&sockets_lock);
+		return -1;
+	}
+
+	*s = (struct sim_socket){
+		.used = true,
+		.stream = (type == SOCK_STREAM),
+		.secure = proto_secure(proto),
+		.rai = RAI_ACTION_NONE,
+	};
+
+	creating = k_current_get();
+	s->inner = zsock_socket(family, type,
+				s->secure ? ((type == SOCK_STREAM) ? IPPROTO_TCP : IPPROTO_UDP) :
+					    proto);
+	creating = NULL;
+
+	if (s->inner < 0) {
+		s->used = false;
+		z_free_fd(fd);
+		k_mutex_unlock(&sockets_lock);
+		return -1;
+	}
+
+	z_finalize_fd(fd, s, (const struct fd_op_vtable *)&sim_socket_vtable);
+
+	k_mutex_unlock(&sockets_lock);
+
+	return fd;
+}
+
+NET_SOCKET_OFFLOAD_REGISTER(modem_sim, CONFIG_MODEM_SIM_SOCKETS_PRIORITY, AF_UNSPEC,
+			    sim_socket_is_supported, sim_socket_create);